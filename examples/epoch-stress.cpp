@@ -0,0 +1,147 @@
+#include "../include/rpc-light/dispatcher.hpp"
+#include "../include/rpc-light/epoch.hpp"
+#include <string>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+//replaces versions protected by epoch reclamation while reader threads keep reading them. first a bare
+//epoch_domain_t guarding a pointer whose old targets are poisoned and freed once safe, then a dispatcher whose
+//methods are added, replaced and removed while readers call them. a reader that sees a poisoned or out of
+//order version reports it, build with -fsanitize=address to also catch any read of a freed version.
+//usage: epoch-stress [seconds per phase] [readers]
+
+struct version_t
+{
+    static constexpr uint64_t LIVE = 0x6c697665, DEAD = 0x64656164;
+    std::atomic<uint64_t> state;
+    uint64_t number;
+};
+
+std::size_t bare_domain(const std::chrono::seconds &duration, const std::size_t &readers)
+{
+    auto &domain = rpc_light::epoch_domain_t::instance();
+    std::atomic<const version_t *> current(new version_t{{version_t::LIVE}, 0});
+    std::atomic<bool> done(false);
+    std::atomic<std::size_t> errors(0), reads(0);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < readers; i++)
+        threads.emplace_back([&] {
+            uint64_t last = 0;
+            std::size_t count = 0;
+            while (!done)
+            {
+                rpc_light::epoch_domain_t::guard_t guard(domain);
+                auto version = current.load(std::memory_order_seq_cst);
+                //nested guards must not end the outer one's protection
+                {
+                    rpc_light::epoch_domain_t::guard_t inner(domain);
+                }
+                if (version->state != version_t::LIVE || version->number < last)
+                    errors++;
+
+                last = version->number;
+                count++;
+            }
+            reads += count;
+        });
+
+    std::vector<std::pair<uint64_t, version_t *>> retired;
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    uint64_t number = 0;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        auto previous = current.exchange(new version_t{{version_t::LIVE}, ++number}, std::memory_order_seq_cst);
+        retired.emplace_back(domain.advance(), const_cast<version_t *>(previous));
+
+        auto iter = retired.begin();
+        for (; iter != retired.end() && domain.safe(iter->first); ++iter)
+        {
+            iter->second->state = version_t::DEAD;
+            delete iter->second;
+        }
+        retired.erase(retired.begin(), iter);
+    }
+
+    done = true;
+    for (auto &e : threads)
+        e.join();
+
+    for (auto &e : retired)
+        delete e.second;
+
+    delete current.load();
+    std::cout << "epoch_domain_t: " << number << " versions, " << reads << " reads, " << retired.size()
+              << " left unreclaimed at the end, " << errors << " bad read(s)" << std::endl;
+    return errors;
+}
+
+std::size_t dispatcher(const std::chrono::seconds &duration, const std::size_t &readers)
+{
+    rpc_light::dispatcher_t dispatcher;
+    dispatcher.add_method("version", [] { return 0; });
+    std::atomic<bool> done(false);
+    std::atomic<std::size_t> errors(0), calls(0);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < readers; i++)
+        threads.emplace_back([&] {
+            int last = 0;
+            std::size_t count = 0;
+            rpc_light::request_t version("version", rpc_light::array_t{}, 1), extra("extra", rpc_light::array_t{2}, 1);
+            while (!done)
+            {
+                //a reader never sees an older method table than one it has already read
+                auto number = dispatcher.call(version).get_value<int>();
+                if (number < last)
+                    errors++;
+
+                last = number;
+                try
+                {
+                    if (dispatcher.call(extra).get_value<int>() != 4)
+                        errors++;
+                }
+                catch (const rpc_light::ex_bad_method &)
+                {
+                }
+                count++;
+            }
+            calls += count;
+        });
+
+    rpc_light::method_options_t replace;
+    replace.replace = true;
+    auto deadline = std::chrono::steady_clock::now() + duration;
+    int number = 0;
+    while (std::chrono::steady_clock::now() < deadline)
+    {
+        number++;
+        dispatcher.add_method("version", [number] { return number; }, replace);
+        if (number % 2)
+            dispatcher.add_method("extra", [](int value) { return value * 2; });
+
+        else
+            dispatcher.remove_method("extra");
+    }
+
+    done = true;
+    for (auto &e : threads)
+        e.join();
+
+    std::cout << "dispatcher_t: " << number << " table versions, " << calls << " calls, " << errors << " bad call(s)" << std::endl;
+    return errors;
+}
+
+int main(int argc, char **argv)
+{
+    std::chrono::seconds duration(argc > 1 ? std::stoul(argv[1]) : 2);
+    std::size_t readers = argc > 2 ? std::stoul(argv[2]) : std::max(2u, std::thread::hardware_concurrency());
+
+    auto errors = bare_domain(duration, readers) + dispatcher(duration, readers);
+    return errors == 0 ? 0 : 1;
+}
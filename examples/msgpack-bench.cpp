@@ -0,0 +1,70 @@
+#include "../include/rpc-light/server.hpp"
+#include "../include/rpc-light/msgpack.hpp"
+#include <string>
+#include <iostream>
+#include <vector>
+#include <chrono>
+
+//compares the size of a request with a large params array and the time to handle it in json and in
+//messagepack, through handle_request_into on the calling thread. the json side uses whichever reader the
+//build selects, rapidjson by default or simdjson with RPC_LIGHT_SIMDJSON, so build it both ways to compare
+//against each.
+//usage: msgpack-bench [array size] [iterations]
+
+double sum(const std::vector<double> &values)
+{
+    double total = 0;
+    for (auto &e : values)
+        total += e;
+
+    return total;
+}
+
+template <typename value_type>
+rpc_light::request_t make_request(const std::size_t &size)
+{
+    std::vector<value_type> values;
+    values.reserve(size);
+    for (std::size_t i = 0; i < size; i++)
+        values.push_back(std::is_floating_point_v<value_type> ? static_cast<value_type>(i / 7.0) : static_cast<value_type>(i * 37));
+
+    return rpc_light::request_t("sum", rpc_light::array_t{rpc_light::value_t(values)}, 1);
+}
+
+double run(rpc_light::server_t &server, const std::string &request, const std::size_t &iterations)
+{
+    std::string output;
+    server.handle_request_into(request, output);
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; i++)
+        server.handle_request_into(request, output);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t size = argc > 1 ? std::stoul(argv[1]) : 20000;
+    std::size_t iterations = argc > 2 ? std::stoul(argv[2]) : 200;
+
+    rpc_light::server_t server;
+    server.get_dispatcher().add_method("sum", &sum);
+
+#ifdef RPC_LIGHT_SIMDJSON
+    std::cout << "json reader: simdjson" << std::endl;
+#else
+    std::cout << "json reader: rapidjson" << std::endl;
+#endif
+
+    auto report = [&](const char *name, const rpc_light::request_t &request) {
+        auto json = rpc_light::json_codec_t::serialize_request(request);
+        auto msgpack = rpc_light::msgpack_codec_t::serialize_request(request);
+        std::cout << name << ": json " << json.size() / 1024 << " KB, " << run(server, json, iterations) << " ms"
+                  << "   msgpack " << msgpack.size() / 1024 << " KB, " << run(server, msgpack, iterations) << " ms" << std::endl;
+    };
+    report("doubles ", make_request<double>(size));
+    report("integers", make_request<int64_t>(size));
+    return 0;
+}
@@ -0,0 +1,96 @@
+#include "../include/rpc-light/server.hpp"
+#include "../include/rpc-light/numa.hpp"
+#include <string>
+#include <iostream>
+#include <chrono>
+#include <atomic>
+#include <future>
+
+//compares a request whose value_t tree is used on the node that built it with one handed to a worker on
+//another node. on a single node machine the remote case is simulated with the two cpus furthest apart,
+//which still shows the cost of handing a freshly built tree to another core's cache.
+//usage: numa-bench [requests]
+
+double sum(const rpc_light::array_t &values, const rpc_light::struct_t &weights)
+{
+    double total = 0;
+    for (auto &e : values)
+        total += e.get_value<double>();
+
+    for (auto &e : weights)
+        total *= e.second.get_value<double>();
+
+    return total;
+}
+
+void pin_self(const int &cpu)
+{
+#ifdef __linux__
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpu_set);
+#endif
+}
+
+std::string make_request()
+{
+    std::string request = R"({"jsonrpc":"2.0","method":"sum","params":[[)";
+    for (int i = 0; i < 256; i++)
+        request += std::to_string(i) + ".5" + (i < 255 ? "," : "");
+
+    request += R"(],{"a":1.0,"b":1.0,"c":1.0}],"id":1})";
+    return request;
+}
+
+template <typename post_type>
+double run(const int &receiver_cpu, const int &worker_cpu, const std::size_t &requests, const post_type &post)
+{
+    pin_self(receiver_cpu);
+    rpc_light::executor_config_t config;
+    config.cpu_affinity = {worker_cpu};
+    rpc_light::server_t server(config);
+    server.get_dispatcher().add_method("sum", &sum);
+
+    auto request = make_request();
+    std::atomic<std::size_t> remaining(requests);
+    std::promise<void> done;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < requests; i++)
+        post(server, request, [&] {
+            if (remaining.fetch_sub(1) == 1)
+                done.set_value();
+        });
+
+    done.get_future().wait();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return requests / elapsed.count();
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t requests = argc > 1 ? std::stoul(argv[1]) : 200000;
+    auto &nodes = rpc_light::numa::nodes();
+    auto &near = nodes.front();
+    auto &far = nodes.back();
+
+    auto receiver_cpu = near.cpus.front();
+    auto local_cpu = near.cpus.size() > 1 ? near.cpus[1] : near.cpus.front();
+    auto remote_cpu = far.cpus.back();
+    std::cout << nodes.size() << " numa node(s)" << (nodes.size() == 1 ? ", remote placement is simulated" : "") << std::endl;
+
+    //the receiving thread builds the tree and the worker runs the method on it, only the worker's cpu differs
+    auto post = [](auto &server, const std::string &request, auto done) {
+        auto parsed = std::make_shared<const rpc_light::request_t>(rpc_light::json_codec_t::deserialize_request(request));
+        server.get_executor().post([&server, parsed, done] {
+            rpc_light::json_codec_t::serialize_response(server.get_dispatcher().invoke(*parsed));
+            done();
+        });
+    };
+    auto local = run(receiver_cpu, local_cpu, requests, post);
+    auto remote = run(receiver_cpu, remote_cpu, requests, post);
+
+    std::cout << "local  cpu " << receiver_cpu << " -> " << local_cpu << ": " << static_cast<uint64_t>(local) << " req/s" << std::endl;
+    std::cout << "remote cpu " << receiver_cpu << " -> " << remote_cpu << ": " << static_cast<uint64_t>(remote) << " req/s" << std::endl;
+    return 0;
+}
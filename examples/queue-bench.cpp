@@ -0,0 +1,171 @@
+#include "../include/rpc-light/queue.hpp"
+#include <string>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <atomic>
+
+//hands std::function work from many producer threads to a few consumers, once through the lock-free ring the
+//executor uses and once through the deque behind a mutex and condition variable it replaced. every item marks
+//its own slot when it runs, so the run also checks that each one is delivered exactly once.
+//numbers only mean something on a machine with at least as many cores as producers and consumers together.
+//usage: queue-bench [items per producer]
+
+using work_t = std::function<void()>;
+
+class mutex_queue_t
+{
+    std::mutex m_mutex;
+    std::condition_variable m_event;
+    std::deque<work_t> m_queue;
+
+public:
+    void push(work_t &&work)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_queue.push_back(std::move(work));
+        }
+        m_event.notify_one();
+    }
+
+    bool pop(work_t &work, const std::atomic<bool> &done)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_event.wait(lock, [&] { return !m_queue.empty() || done; });
+        if (m_queue.empty())
+            return false;
+
+        work = std::move(m_queue.front());
+        m_queue.pop_front();
+        return true;
+    }
+
+    void close()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        lock.unlock();
+        m_event.notify_all();
+    }
+};
+
+class ring_queue_t
+{
+    rpc_light::mpmc_queue_t<work_t> m_queue{4096};
+
+public:
+    //producers yield while the ring is full, as the executor's do
+    void push(work_t &&work)
+    {
+        while (!m_queue.try_push(std::move(work)))
+            std::this_thread::yield();
+    }
+
+    bool pop(work_t &work, const std::atomic<bool> &done)
+    {
+        while (!m_queue.try_pop(work))
+        {
+            if (done)
+                return false;
+
+            std::this_thread::yield();
+        }
+        return true;
+    }
+
+    void close() {}
+};
+
+struct measurement_t
+{
+    double items_per_second;
+    std::size_t missing, repeated;
+};
+
+template <typename queue_type>
+measurement_t run(const std::size_t &producers, const std::size_t &consumers, const std::size_t &items)
+{
+    queue_type queue;
+    std::vector<std::atomic<uint8_t>> delivered(producers * items);
+    std::atomic<std::size_t> remaining(producers * items);
+    std::atomic<bool> done(false);
+    std::atomic<bool> go(false);
+
+    std::vector<std::thread> threads;
+    for (std::size_t i = 0; i < consumers; i++)
+        threads.emplace_back([&] {
+            work_t work;
+            while (queue.pop(work, done))
+            {
+                work();
+                work = nullptr;
+            }
+        });
+
+    for (std::size_t i = 0; i < producers; i++)
+        threads.emplace_back([&, i] {
+            while (!go)
+                std::this_thread::yield();
+
+            for (std::size_t j = 0; j < items; j++)
+            {
+                auto slot = &delivered[i * items + j];
+                queue.push([slot, &remaining, &done, &queue] {
+                    slot->fetch_add(1, std::memory_order_relaxed);
+                    if (remaining.fetch_sub(1) == 1)
+                    {
+                        done = true;
+                        queue.close();
+                    }
+                });
+            }
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    go = true;
+    for (auto &e : threads)
+        e.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    measurement_t result{producers * items / elapsed.count(), 0, 0};
+    for (auto &e : delivered)
+    {
+        if (e == 0)
+            result.missing++;
+
+        else if (e > 1)
+            result.repeated++;
+    }
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    std::size_t items = argc > 1 ? std::stoul(argv[1]) : 100000;
+    std::cout << std::thread::hardware_concurrency() << " hardware thread(s), " << items << " items per producer" << std::endl;
+
+    bool exact = true;
+    for (std::size_t producers : {16, 32, 64})
+        for (std::size_t consumers : {1, 4, 16})
+        {
+            auto locked = run<mutex_queue_t>(producers, consumers, items);
+            auto ring = run<ring_queue_t>(producers, consumers, items);
+            std::cout << "producers " << producers << " consumers " << consumers
+                      << ": mutex+cv " << locked.items_per_second / 1e6 << " Mops/s, ring " << ring.items_per_second / 1e6 << " Mops/s" << std::endl;
+
+            for (auto &e : {locked, ring})
+                if (e.missing || e.repeated)
+                {
+                    std::cout << "  " << e.missing << " item(s) lost, " << e.repeated << " delivered more than once" << std::endl;
+                    exact = false;
+                }
+        }
+
+    std::cout << (exact ? "every item was delivered exactly once" : "delivery check failed") << std::endl;
+    return exact ? 0 : 1;
+}
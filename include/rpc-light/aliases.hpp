@@ -4,7 +4,9 @@
 #include <functional>
 #include <vector>
 #include <map>
+#include <unordered_map>
 #include <variant>
+#include <cstdint>
 
 namespace rpc_light
 {
@@ -12,10 +14,22 @@ namespace rpc_light
     struct response_t;
     using array_t = std::vector<value_t>;
     using struct_t = std::map<std::string, value_t>;
+    //arrays holding only numbers are kept in contiguous storage
+    using double_array_t = std::vector<double>;
+    using int_array_t = std::vector<int64_t>;
     using method_t = std::function<value_t(array_t)>;
     using null_t = std::monostate;
     using batch_t = std::vector<response_t>;
     using param_map_t = std::unordered_map<unsigned int, std::string>;
+    //values for named params the client may leave out, keyed by param index
+    using param_defaults_t = std::unordered_map<unsigned int, value_t>;
+    //scheduling lane of a request, see executor_config_t::lane_weights
+    enum class priority_t
+    {
+        high,
+        normal,
+        low
+    };
     const char
         JSON_PROTO[] = "jsonrpc",
         JSON_VER[] = "2.0",
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <array>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //standard alphabet with padding, used to carry blobs through json.
+    //both directions work on whole groups of 3 bytes / 4 characters without per-character branches
+    namespace base64
+    {
+        constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        constexpr uint8_t INVALID = 0xff;
+
+        constexpr std::array<uint8_t, 256> make_decode_table()
+        {
+            std::array<uint8_t, 256> table{};
+            for (auto &e : table)
+                e = INVALID;
+
+            for (uint8_t i = 0; i < 64; i++)
+                table[static_cast<uint8_t>(ALPHABET[i])] = i;
+
+            return table;
+        }
+
+        constexpr auto DECODE_TABLE = make_decode_table();
+
+        const std::size_t encoded_size(const std::size_t &size)
+        {
+            return (size + 2) / 3 * 4;
+        }
+
+        //appends the encoding of data to output
+        void encode(const uint8_t *data, const std::size_t &size, std::string &output)
+        {
+            auto offset = output.size();
+            output.resize(offset + encoded_size(size));
+            auto *dst = &output[offset];
+            std::size_t i = 0;
+            for (; i + 3 <= size; i += 3, dst += 4)
+            {
+                uint32_t group = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | data[i + 2];
+                dst[0] = ALPHABET[group >> 18];
+                dst[1] = ALPHABET[(group >> 12) & 0x3f];
+                dst[2] = ALPHABET[(group >> 6) & 0x3f];
+                dst[3] = ALPHABET[group & 0x3f];
+            }
+
+            if (auto rest = size - i; rest > 0)
+            {
+                uint32_t group = (uint32_t(data[i]) << 16) | (rest > 1 ? uint32_t(data[i + 1]) << 8 : 0);
+                dst[0] = ALPHABET[group >> 18];
+                dst[1] = ALPHABET[(group >> 12) & 0x3f];
+                dst[2] = rest > 1 ? ALPHABET[(group >> 6) & 0x3f] : '=';
+                dst[3] = '=';
+            }
+        }
+
+        const std::string encode(const uint8_t *data, const std::size_t &size)
+        {
+            std::string output;
+            encode(data, size, output);
+            return output;
+        }
+
+        //accepts padded and unpadded input, anything outside the alphabet throws
+        std::vector<uint8_t> decode(const std::string_view &str)
+        {
+            auto size = str.size();
+            if (size % 4 == 0 && size > 0 && str[size - 1] == '=')
+                size -= str[size - 2] == '=' ? 2 : 1;
+
+            if (size % 4 == 1)
+                throw ex_internal_error("Invalid base64.");
+
+            std::vector<uint8_t> output(size / 4 * 3 + (size % 4 ? size % 4 - 1 : 0));
+            auto *src = reinterpret_cast<const uint8_t *>(str.data());
+            auto *dst = output.data();
+            uint8_t invalid = 0;
+            std::size_t i = 0;
+            for (; i + 4 <= size; i += 4, dst += 3)
+            {
+                uint8_t a = DECODE_TABLE[src[i]], b = DECODE_TABLE[src[i + 1]],
+                        c = DECODE_TABLE[src[i + 2]], d = DECODE_TABLE[src[i + 3]];
+                invalid |= a | b | c | d;
+                uint32_t group = (uint32_t(a & 0x3f) << 18) | (uint32_t(b & 0x3f) << 12) | (uint32_t(c & 0x3f) << 6) | (d & 0x3f);
+                dst[0] = static_cast<uint8_t>(group >> 16);
+                dst[1] = static_cast<uint8_t>(group >> 8);
+                dst[2] = static_cast<uint8_t>(group);
+            }
+
+            if (auto rest = size - i; rest > 0)
+            {
+                uint8_t a = DECODE_TABLE[src[i]], b = DECODE_TABLE[src[i + 1]],
+                        c = rest > 2 ? DECODE_TABLE[src[i + 2]] : 0;
+                invalid |= a | b | c;
+                uint32_t group = (uint32_t(a & 0x3f) << 18) | (uint32_t(b & 0x3f) << 12) | (uint32_t(c & 0x3f) << 6);
+                dst[0] = static_cast<uint8_t>(group >> 16);
+                if (rest > 2)
+                    dst[1] = static_cast<uint8_t>(group >> 8);
+            }
+
+            //valid entries are below 64, the invalid marker sets the top bits
+            if (invalid & 0xc0)
+                throw ex_internal_error("Invalid base64.");
+
+            return output;
+        }
+    }; // namespace base64
+} // namespace rpc_light
\ No newline at end of file
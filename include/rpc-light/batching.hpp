@@ -0,0 +1,389 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "codec.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "result.hpp"
+#include "client.hpp"
+
+#include <string>
+#include <future>
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <optional>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace rpc_light
+{
+    struct batch_config_t
+    {
+        //longest a call waits for others to share its message, measured from the first call of the batch
+        std::chrono::microseconds window{200};
+        //a batch is sent as soon as it holds this many calls or this many bytes
+        std::size_t max_requests = 64;
+        std::size_t max_bytes = 64 * 1024;
+    };
+
+    //a client that gathers the calls made within a short window into one batch message, trading a little
+    //latency for far fewer messages on the transport. every call is serialized straight into the pending batch
+    //and gets a generated id, the transport sends what send receives and passes every response message back
+    //to handle_response, which hands each response in it to the call with its id. calls of a batch that the
+    //reply leaves unanswered fail, see handle_response
+    template <typename codec_type = auto_codec_t>
+    class basic_batching_client_t
+    {
+        using completion_t = std::function<void(const response_t &)>;
+        using send_t = std::function<void(std::string message)>;
+
+        struct pending_t
+        {
+            completion_t done;
+            //sequence number of the batch the call was sent in
+            uint64_t batch;
+        };
+
+        const batch_config_t m_config;
+        const send_t m_send;
+        basic_client_t<codec_type> m_client;
+        std::atomic<int64_t> m_next_id{1};
+
+        //the serialized calls of the batch being gathered and where each one ends, in the client's format at
+        //the time the batch was opened
+        std::mutex m_mutex;
+        std::condition_variable m_event;
+        std::string m_output;
+        std::vector<std::size_t> m_ends;
+        std::chrono::steady_clock::time_point m_opened;
+        format_t m_format;
+        //ids of the calls in the batch being gathered and the sequence number it is sent with
+        std::vector<int64_t> m_ids;
+        uint64_t m_batch = 0;
+        bool m_running = true;
+        std::thread m_flusher;
+        //taken before m_mutex is released and held while sending, so batches go out in sequence order
+        std::mutex m_send_mutex;
+
+        mutable std::mutex m_pending_mutex;
+        std::unordered_map<int64_t, pending_t> m_pending;
+        //ids of the unanswered calls of every sent batch, oldest batch first
+        std::map<uint64_t, std::vector<int64_t>> m_batches;
+
+        //sends the gathered calls, lock holds m_mutex and is released before the transport is called
+        void send(std::unique_lock<std::mutex> &lock)
+        {
+            auto message = take();
+            std::unique_lock<std::mutex> send_lock(m_send_mutex);
+            lock.unlock();
+            m_send(std::move(message));
+        }
+
+        //joins the gathered calls into a batch message, the lock is held
+        const std::string take()
+        {
+            if (!m_ids.empty())
+            {
+                std::unique_lock<std::mutex> lock(m_pending_mutex);
+                m_batches.emplace(m_batch, std::move(m_ids));
+                m_ids.clear();
+            }
+            m_batch++;
+
+            auto message = codec_type::visit(m_format, [&](auto codec) {
+                typename decltype(codec)::batch_writer_t writer;
+                std::string output;
+                output.reserve(m_output.size() + m_ends.size() + 8);
+                std::size_t begin = 0;
+                for (auto &end : m_ends)
+                {
+                    writer.next(output);
+                    output.append(m_output, begin, end - begin);
+                    begin = end;
+                }
+                writer.finish(output);
+                return output;
+            });
+            m_output.clear();
+            m_ends.clear();
+            return message;
+        }
+
+        void flusher_proc()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            while (m_running)
+            {
+                if (m_ends.empty())
+                {
+                    m_event.wait(lock);
+                    continue;
+                }
+
+                auto deadline = m_opened + m_config.window;
+                if (std::chrono::steady_clock::now() < deadline)
+                {
+                    m_event.wait_until(lock, deadline);
+                    continue;
+                }
+
+                send(lock);
+                lock.lock();
+            }
+        }
+
+        void enqueue(request_t &&request, completion_t &&done)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_ends.empty())
+            {
+                m_format = m_client.get_format();
+                m_opened = std::chrono::steady_clock::now();
+                m_event.notify_one();
+            }
+
+            if (done)
+            {
+                auto id = request.get_id().template get_value<int64_t>();
+                std::unique_lock<std::mutex> pending_lock(m_pending_mutex);
+                m_pending.emplace(id, pending_t{std::move(done), m_batch});
+                m_ids.push_back(id);
+            }
+
+            m_output.append(codec_type::visit(m_format, [&](auto codec) { return codec.serialize_request(request); }));
+            m_ends.push_back(m_output.size());
+            if (m_ends.size() >= m_config.max_requests || m_output.size() >= m_config.max_bytes)
+                send(lock);
+        }
+
+        //removes the call with id from the pending calls and from its batch, the lock is held
+        bool take_pending(const int64_t &id, pending_t &pending)
+        {
+            auto iter = m_pending.find(id);
+            if (iter == m_pending.end())
+                return false;
+
+            pending = std::move(iter->second);
+            m_pending.erase(iter);
+            if (auto batch = m_batches.find(pending.batch); batch != m_batches.end())
+            {
+                auto &ids = batch->second;
+                ids.erase(std::find(ids.begin(), ids.end(), id));
+                if (ids.empty())
+                    m_batches.erase(batch);
+            }
+            return true;
+        }
+
+        //the calls of a batch still waiting, the lock is held
+        std::vector<completion_t> take_batch(const std::map<uint64_t, std::vector<int64_t>>::iterator &batch)
+        {
+            std::vector<completion_t> calls;
+            for (auto &e : batch->second)
+                if (auto iter = m_pending.find(e); iter != m_pending.end())
+                {
+                    calls.push_back(std::move(iter->second.done));
+                    m_pending.erase(iter);
+                }
+
+            m_batches.erase(batch);
+            return calls;
+        }
+
+        //completes the call the response answers and returns the sequence number of its batch
+        std::optional<uint64_t> complete(const response_t &response)
+        {
+            pending_t pending;
+            {
+                std::unique_lock<std::mutex> lock(m_pending_mutex);
+                int64_t id;
+                try
+                {
+                    id = response.get_id().template get_value<int64_t>();
+                }
+                catch (...)
+                {
+                    return std::nullopt;
+                }
+                if (!take_pending(id, pending))
+                    return std::nullopt;
+            }
+            pending.done(response);
+            return pending.batch;
+        }
+
+        //an error without an id answers a whole batch message, like one that could not be parsed. a server
+        //may answer batches in any order, so which one it answers is unknown and every sent batch fails with it.
+        //calls gathered for the next batch are not sent yet and keep waiting
+        void fail_sent(const response_t &error)
+        {
+            std::vector<completion_t> calls;
+            {
+                std::unique_lock<std::mutex> lock(m_pending_mutex);
+                while (!m_batches.empty())
+                {
+                    auto batch = take_batch(m_batches.begin());
+                    calls.insert(calls.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+                }
+            }
+            for (auto &e : calls)
+                e(error);
+        }
+
+        //a batch reply answers every call of the batch at once, the calls it leaves out get no response later
+        void fail_unanswered(const uint64_t &batch)
+        {
+            std::vector<completion_t> calls;
+            {
+                std::unique_lock<std::mutex> lock(m_pending_mutex);
+                auto iter = m_batches.find(batch);
+                if (iter == m_batches.end())
+                    return;
+
+                calls = take_batch(iter);
+            }
+            response_t error(-32603, "No response to the call in the batch reply.");
+            for (auto &e : calls)
+                e(error);
+        }
+
+    public:
+        //send is called with each batch message, on the thread whose call filled the batch or on the
+        //client's flusher thread when the window closes. calls to it are serialized in the order the batches
+        //were formed, so send must not make calls on this client itself
+        basic_batching_client_t(send_t send, const batch_config_t &config = batch_config_t(), const executor_config_t &executor_config = executor_config_t())
+            : m_config(config), m_send(std::move(send)), m_client(executor_config), m_format(m_client.get_format())
+        {
+            m_flusher = std::thread(&basic_batching_client_t::flusher_proc, this);
+        }
+
+        basic_batching_client_t(const basic_batching_client_t &) = delete;
+        basic_batching_client_t &operator=(const basic_batching_client_t &) = delete;
+
+        //sends what is still gathered, calls waiting on a response are not completed
+        ~basic_batching_client_t()
+        {
+            flush();
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_running = false;
+            }
+            m_event.notify_one();
+            m_flusher.join();
+            //responses still queued on the workers complete against m_pending
+            m_client.stop();
+        }
+
+        //the callback runs on one of the client's workers
+        template <typename callback_type, typename params_type = array_t>
+        void call(const std::string_view &method_name, const params_type &params, callback_type callback)
+        {
+            auto id = m_next_id.fetch_add(1, std::memory_order_relaxed);
+            enqueue(request_t(method_name, params, id), completion_t(std::move(callback)));
+        }
+
+        template <typename params_type = array_t>
+        auto call(const std::string_view &method_name, const params_type &params = {})
+        {
+            auto promise = std::make_shared<std::promise<const response_t>>();
+            auto response = promise->get_future();
+            call(method_name, params, [promise](const response_t &response) { promise->set_value(response); });
+            return response;
+        }
+
+        //goes out with the next batch, there is nothing to wait for
+        template <typename params_type = array_t>
+        void notify(const std::string_view &method_name, const params_type &params = {})
+        {
+            enqueue(request_t(method_name, params), nullptr);
+        }
+
+        //sends the gathered calls now instead of when the window closes
+        void flush()
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_ends.empty())
+                return;
+
+            send(lock);
+        }
+
+        //parses the response message on a worker and completes the calls it answers. calls of a batch the
+        //reply leaves out fail with an internal error. an error without an id, sent when the server could not
+        //read a batch message, answers no call and fails every call of every sent batch, see fail_sent
+        void handle_response(std::string response_string)
+        {
+            m_client.handle_response(std::move(response_string), [this](const result_t &result) {
+                if (!result.has_response())
+                    return;
+
+                if (!result.is_batch())
+                {
+                    auto &response = result.get_response();
+                    if (!complete(response) && response.has_error() && !response.get_id().has_value())
+                        fail_sent(response);
+
+                    return;
+                }
+
+                std::vector<uint64_t> batches;
+                const response_t *unmatched = nullptr;
+                for (auto &e : result.get_batch())
+                {
+                    if (auto batch = complete(e))
+                    {
+                        if (std::find(batches.begin(), batches.end(), *batch) == batches.end())
+                            batches.push_back(*batch);
+                    }
+                    else if (e.has_error() && !e.get_id().has_value())
+                        unmatched = &e;
+                }
+
+                //a reply of only id-less errors cannot be tied to the batch it answers
+                if (batches.empty() && unmatched)
+                    return fail_sent(*unmatched);
+
+                for (auto &e : batches)
+                    fail_unanswered(e);
+            });
+        }
+
+        //completes every call still waiting with error, e.g. when the connection it was sent on is lost
+        void fail_pending(const response_t &error)
+        {
+            std::unordered_map<int64_t, pending_t> pending;
+            {
+                std::unique_lock<std::mutex> lock(m_pending_mutex);
+                pending.swap(m_pending);
+                m_batches.clear();
+            }
+            for (auto &e : pending)
+                e.second.done(error);
+        }
+
+        const inline std::size_t pending() const
+        {
+            std::unique_lock<std::mutex> lock(m_pending_mutex);
+            return m_pending.size();
+        }
+
+        //calls are created in this format, see basic_client_t::set_format
+        void set_format(const format_t &format)
+        {
+            m_client.set_format(format);
+        }
+    };
+
+    using batching_client_t = basic_batching_client_t<>;
+} // namespace rpc_light
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "base64.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //immutable byte buffer, copies share the same storage so binary payloads pass through dispatch
+    //without the bytes being copied. json carries blobs as base64 strings, binary codecs as raw bytes
+    class blob_t
+    {
+        std::shared_ptr<const void> m_owner;
+        const uint8_t *m_data = nullptr;
+        std::size_t m_size = 0;
+
+    public:
+        blob_t() {}
+
+        //copies the bytes into storage owned by the blob
+        blob_t(const void *data, const std::size_t &size)
+            : blob_t(std::vector<uint8_t>(static_cast<const uint8_t *>(data), static_cast<const uint8_t *>(data) + size)) {}
+
+        //takes over the vector without copying
+        blob_t(std::vector<uint8_t> &&bytes)
+        {
+            auto owner = std::make_shared<const std::vector<uint8_t>>(std::move(bytes));
+            m_data = owner->data();
+            m_size = owner->size();
+            m_owner = std::move(owner);
+        }
+
+        //shares a buffer that owner keeps alive
+        blob_t(std::shared_ptr<const void> owner, const void *data, const std::size_t &size)
+            : m_owner(std::move(owner)), m_data(static_cast<const uint8_t *>(data)), m_size(size) {}
+
+        //views a buffer without owning it, the caller keeps it alive while the blob or any copy is in use
+        static const blob_t borrow(const void *data, const std::size_t &size)
+        {
+            return blob_t(nullptr, data, size);
+        }
+
+        static const blob_t from_base64(const std::string_view &str)
+        {
+            return blob_t(base64::decode(str));
+        }
+
+        const inline std::string to_base64() const
+        {
+            return base64::encode(m_data, m_size);
+        }
+
+        const inline uint8_t *data() const
+        {
+            return m_data;
+        }
+
+        const inline std::size_t size() const
+        {
+            return m_size;
+        }
+
+        const inline bool empty() const
+        {
+            return m_size == 0;
+        }
+
+        const inline uint8_t *begin() const
+        {
+            return m_data;
+        }
+
+        const inline uint8_t *end() const
+        {
+            return m_data + m_size;
+        }
+
+        const inline std::string_view view() const
+        {
+            return std::string_view(reinterpret_cast<const char *>(m_data), m_size);
+        }
+
+        const inline bool is_borrowed() const
+        {
+            return !m_owner && m_data;
+        }
+
+        const bool operator==(const blob_t &other) const
+        {
+            return m_size == other.m_size && (m_size == 0 || m_data == other.m_data || std::memcmp(m_data, other.m_data, m_size) == 0);
+        }
+
+        const bool operator!=(const blob_t &other) const
+        {
+            return !(*this == other);
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
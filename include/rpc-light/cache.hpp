@@ -0,0 +1,159 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "request.hpp"
+#include "msgpack.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //canonical encoding of the request params, equal params give equal keys. named params are already ordered by name
+    void append_params_key(std::string &key, const request_t &request)
+    {
+        if (!request.has_params())
+            return;
+
+        if (request.has_named_params())
+        {
+            auto &params = request.get_params_str();
+            msgpack::write_map(key, params.size());
+            for (auto &e : params)
+            {
+                msgpack::write_string(key, e.first);
+                msgpack::write_value(key, e.second);
+            }
+        }
+        else
+        {
+            auto &params = request.get_params_arr();
+            msgpack::write_array(key, params.size());
+            for (auto &e : params)
+                msgpack::write_value(key, e);
+        }
+    }
+
+    struct cache_config_t
+    {
+        //how long a stored result is served before the method runs again
+        std::chrono::milliseconds ttl{1000};
+        //distinct params kept per method, the oldest entry is evicted when full
+        std::size_t max_entries = 1024;
+    };
+
+    //a cached result, both as a value for result_t and as the serialized result member
+    struct cache_entry_t
+    {
+        value_t value;
+        std::string fragment;
+        std::chrono::steady_clock::time_point expires;
+    };
+
+    //results of one idempotent method keyed by its params. the key is the canonical encoding of the params
+    //prefixed with the wire format, since the fragment is already encoded,
+    //hits only take a shared lock, entries are evicted in insertion order
+    class result_cache_t
+    {
+        using clock_t = std::chrono::steady_clock;
+
+        struct slot_t
+        {
+            std::shared_ptr<const cache_entry_t> entry;
+            std::list<std::string>::iterator order;
+        };
+
+        const cache_config_t m_config;
+        mutable std::shared_mutex m_mutex;
+        std::unordered_map<std::string, slot_t> m_entries;
+        std::list<std::string> m_order;
+        mutable std::atomic<uint64_t> m_hits{0}, m_misses{0};
+
+    public:
+        result_cache_t(const cache_config_t &config) : m_config(config) {}
+
+        static const std::string make_key(const uint8_t &format, const request_t &request)
+        {
+            std::string key(1, static_cast<char>(format));
+            append_params_key(key, request);
+            return key;
+        }
+
+        //returns null when the key is missing or expired
+        std::shared_ptr<const cache_entry_t> find(const std::string &key) const
+        {
+            {
+                std::shared_lock<std::shared_mutex> lock(m_mutex);
+                if (auto iter = m_entries.find(key); iter != m_entries.end() && iter->second.entry->expires > clock_t::now())
+                {
+                    m_hits.fetch_add(1, std::memory_order_relaxed);
+                    return iter->second.entry;
+                }
+            }
+            m_misses.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        std::shared_ptr<const cache_entry_t> store(std::string &&key, value_t &&value, std::string &&fragment)
+        {
+            auto entry = std::make_shared<const cache_entry_t>(
+                cache_entry_t{std::move(value), std::move(fragment), clock_t::now() + m_config.ttl});
+            if (m_config.max_entries == 0)
+                return entry;
+
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            if (auto iter = m_entries.find(key); iter != m_entries.end())
+            {
+                iter->second.entry = entry;
+                m_order.splice(m_order.end(), m_order, iter->second.order);
+                return entry;
+            }
+
+            if (m_entries.size() >= m_config.max_entries)
+            {
+                m_entries.erase(m_order.front());
+                m_order.pop_front();
+            }
+            auto order = m_order.insert(m_order.end(), key);
+            m_entries.emplace(std::move(key), slot_t{entry, order});
+            return entry;
+        }
+
+        const inline cache_config_t &config() const
+        {
+            return m_config;
+        }
+
+        void clear()
+        {
+            std::unique_lock<std::shared_mutex> lock(m_mutex);
+            m_entries.clear();
+            m_order.clear();
+        }
+
+        const inline uint64_t hits() const
+        {
+            return m_hits.load(std::memory_order_relaxed);
+        }
+
+        const inline uint64_t misses() const
+        {
+            return m_misses.load(std::memory_order_relaxed);
+        }
+
+        const std::size_t size() const
+        {
+            std::shared_lock<std::shared_mutex> lock(m_mutex);
+            return m_entries.size();
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
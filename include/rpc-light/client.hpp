@@ -3,30 +3,25 @@
 #include "exceptions.hpp"
 #include "aliases.hpp"
 #include "value.hpp"
-#include "reader.hpp"
-#include "writer.hpp"
+#include "codec.hpp"
 #include "request.hpp"
 #include "response.hpp"
 #include "result.hpp"
+#include "executor.hpp"
 
 #include <string>
 #include <future>
 #include <vector>
-#include <mutex>
-#include <condition_variable>
-#include <chrono>
-#include <queue>
+#include <memory>
 
 namespace rpc_light
 {
-    class client_t
+    //codec_type selects the wire formats the client reads and writes, see codec.hpp
+    template <typename codec_type = auto_codec_t>
+    class basic_client_t
     {
-        std::mutex m_mutex;
-        std::future<void> m_worker;
-        std::condition_variable event;
-        std::queue<std::pair<const std::string, std::promise<const result_t>>> m_queue;
-
-        bool worker_running = false;
+        executor_t m_executor;
+        format_t m_format = codec_type::default_format;
 
         const response_t
         handle_error(const std::exception_ptr &e_ptr, const value_t &id = null_t()) const
@@ -69,39 +64,18 @@ namespace rpc_light
             }
         }
 
-        void start_worker()
-        {
-            m_worker = std::async(std::launch::async, &client_t::worker_proc, this);
-            worker_running = true;
-        }
-
-        void worker_proc()
-        {
-            while (true)
-            {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (!event.wait_for(lock, std::chrono::seconds(5), [&] { return !m_queue.empty(); }))
-                {
-                    worker_running = false;
-                    return;
-                }
-                auto& pair = m_queue.front();
-                pair.second.set_value(get_result(pair.first));
-                m_queue.pop();
-            }
-        }
-
-        const result_t get_result(const std::string response_string)
+        template <typename format_type>
+        const result_t get_result(const std::string_view &response_string)
         {
             try
             {
-                if (auto batch = reader::get_batch(response_string); !batch.empty())
+                if (auto batch = format_type::get_batch(response_string); !batch.empty())
                 {
                     std::vector<response_t> responses;
                     bool has_error = false;
                     for (auto &e : batch)
                     {
-                        auto result = get_result(e);
+                        auto result = get_result<format_type>(e);
                         if (result.has_error())
                             has_error = true;
 
@@ -109,7 +83,7 @@ namespace rpc_light
                     }
                     return result_t(responses, has_error);
                 }
-                auto response = reader::deserialize_response(response_string);
+                auto response = format_type::deserialize_response(response_string);
                 return result_t(response);
             }
             catch (...)
@@ -119,61 +93,112 @@ namespace rpc_light
             }
         }
 
+        const std::string serialize_request(const request_t &request) const
+        {
+            return codec_type::visit(m_format, [&](auto codec) { return codec.serialize_request(request); });
+        }
+
     public:
-        auto handle_response(const std::string &response_string)
+        basic_client_t(const executor_config_t &config = executor_config_t())
+            : m_executor(config)
         {
-            std::future<const result_t> result;
-            {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (!worker_running)
-                    start_worker();
+            m_executor.start();
+        }
 
-                result = m_queue.emplace(response_string, std::promise<const result_t>()).second.get_future();
-            }
-            event.notify_all();
+        //workers are started on construction, stop drains queued work and joins the workers
+        void start()
+        {
+            m_executor.start();
+        }
+
+        void stop()
+        {
+            m_executor.stop();
+        }
+
+        auto handle_response(std::string response_string)
+        {
+            auto promise = std::make_shared<std::promise<const result_t>>();
+            auto result = promise->get_future();
+            handle_response(std::move(response_string), [promise](const result_t &result) { promise->set_value(result); });
             return result;
         }
 
+        //the callback runs on a worker and receives the result_t
+        template <typename callback_type>
+        void handle_response(std::string response_string, callback_type callback)
+        {
+            m_executor.post([this, response_string = std::move(response_string), callback = std::move(callback)]() mutable {
+                codec_type::visit(codec_type::detect_format(response_string), [&](auto codec) {
+                    callback(get_result<decltype(codec)>(response_string));
+                });
+            });
+        }
+
+        //requests are created in this format, only codecs with more than one format can change it
+        void set_format(const format_t &format)
+        {
+            m_format = format;
+        }
+
+        const inline format_t get_format() const
+        {
+            return m_format;
+        }
+
         const inline std::string
         create_request(const std::string_view &method_name, const value_t &id) const
         {
-            return writer::serialize_request(request_t(method_name, id));
+            return serialize_request(request_t(method_name, id));
         }
         const inline std::string
         create_request(const std::string_view &method_name, const value_t &id, const std::initializer_list<value_t> &params) const
         {
-            return writer::serialize_request(request_t(method_name, array_t{params}, id));
+            return serialize_request(request_t(method_name, array_t(params), id));
         }
 
         const inline std::string
         create_request(const std::string_view &method_name, const value_t &id, const std::initializer_list<std::pair<const std::string, value_t>> &params) const
         {
-            return writer::serialize_request(request_t(method_name, struct_t{params}, id));
+            return serialize_request(request_t(method_name, struct_t{params}, id));
         }
 
         const inline std::string
         create_request(const std::string_view &method_name) const
         {
-            return writer::serialize_request(request_t(method_name));
+            return serialize_request(request_t(method_name));
         }
 
         const inline std::string
         create_request(const std::string_view &method_name, const std::initializer_list<value_t> &params) const
         {
-            return writer::serialize_request(request_t(method_name, array_t{params}));
+            return serialize_request(request_t(method_name, array_t(params)));
         }
 
         const inline std::string
         create_request(const std::string_view &method_name, const std::initializer_list<std::pair<const std::string, value_t>> &params) const
         {
-            return writer::serialize_request(request_t(method_name, struct_t{params}));
+            return serialize_request(request_t(method_name, struct_t{params}));
         }
 
+        //joins requests made by create_request into a batch as they are, without decoding them again
         template <typename... params_type>
         const inline std::string
         create_batch(const params_type &... params) const
         {
-            return writer::serialize_batch_request({{reader::deserialize_request(params)...}});
+            return codec_type::visit(m_format, [&](auto codec) {
+                typename decltype(codec)::batch_writer_t writer;
+                std::string output;
+                for (auto &e : {std::string_view(params)...})
+                {
+                    writer.next(output);
+                    output.append(e);
+                }
+                writer.finish(output);
+                return output;
+            });
         }
     };
+
+    using client_t = basic_client_t<>;
 } // namespace rpc_light
\ No newline at end of file
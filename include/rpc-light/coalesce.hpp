@@ -0,0 +1,73 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "request.hpp"
+#include "cache.hpp"
+
+#include <string>
+#include <unordered_map>
+#include <future>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //single-flight execution for one method, a call whose params match one that is still running waits for it
+    //and gets its value, or its exception, instead of running the method again. callers build their own
+    //responses so every one keeps its id
+    class flight_group_t
+    {
+        std::mutex m_mutex;
+        std::unordered_map<std::string, std::shared_future<value_t>> m_flights;
+        std::atomic<uint64_t> m_joined{0};
+
+    public:
+        template <typename call_type>
+        const value_t call(const request_t &request, const call_type &call)
+        {
+            std::string key;
+            append_params_key(key, request);
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (auto iter = m_flights.find(key); iter != m_flights.end())
+            {
+                auto flight = iter->second;
+                lock.unlock();
+                m_joined.fetch_add(1, std::memory_order_relaxed);
+                return flight.get();
+            }
+
+            std::promise<value_t> promise;
+            m_flights.emplace(key, promise.get_future().share());
+            lock.unlock();
+
+            //the flight is removed before it completes, later calls start a new one rather than reusing a finished result
+            try
+            {
+                auto value = call();
+                lock.lock();
+                m_flights.erase(key);
+                lock.unlock();
+                promise.set_value(value);
+                return value;
+            }
+            catch (...)
+            {
+                lock.lock();
+                m_flights.erase(key);
+                lock.unlock();
+                promise.set_exception(std::current_exception());
+                throw;
+            }
+        }
+
+        //number of calls that were answered by a flight already in progress
+        const inline uint64_t joined() const
+        {
+            return m_joined.load(std::memory_order_relaxed);
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
@@ -0,0 +1,215 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "reader.hpp"
+#include "writer.hpp"
+#include "msgpack.hpp"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace rpc_light
+{
+    enum class format_t
+    {
+        json,
+        msgpack
+    };
+
+    //a codec is a policy type with only static members, server and client are templates over it so every
+    //call resolves at compile time. a codec for one wire format provides
+    //  is_batch, get_batch, peek, deserialize_request, deserialize_response,
+    //  write_result, write_raw_result, write_error, serialize_value, serialize_request,
+    //  serialize_batch_request, serialize_response and serialize_batch_response
+    //with the signatures of json_codec_t below, plus a batch_writer_t type that joins serialized element responses
+    //into a batch response (see writer::batch_writer_t). deserialize_request decodes params of reflected types with
+    //the decoders its lookup has for the method, see param_lookup_t. every codec provides the selection members
+    //  default_format, detect_format(message) and visit(format, visitor)
+    //where visit calls the visitor with an instance of the single format codec to use for the message.
+    //single_codec_t supplies the selection members for a codec that only speaks one format.
+    template <typename codec_type, format_t codec_format>
+    struct single_codec_t
+    {
+        static constexpr format_t default_format = codec_format;
+
+        static const format_t detect_format(const std::string_view &)
+        {
+            return codec_format;
+        }
+
+        template <typename visitor_type>
+        static decltype(auto) visit(const format_t &, visitor_type &&visitor)
+        {
+            return visitor(codec_type());
+        }
+    };
+
+    struct json_codec_t : single_codec_t<json_codec_t, format_t::json>
+    {
+        using batch_writer_t = writer::batch_writer_t;
+
+        static const bool is_batch(const std::string_view &str)
+        {
+            return reader::is_batch(str);
+        }
+
+        static const std::vector<std::string> get_batch(const std::string_view &str)
+        {
+            return reader::get_batch(str);
+        }
+
+        static const message_hint_t peek(const std::string_view &str)
+        {
+            return reader::peek(str);
+        }
+
+        static const request_t deserialize_request(const std::string_view &request_string, const param_lookup_t *lookup = nullptr)
+        {
+            return reader::deserialize_request(request_string, lookup);
+        }
+
+        static const response_t deserialize_response(const std::string_view &response_string)
+        {
+            return reader::deserialize_response(response_string);
+        }
+
+        static void write_result(std::string &output, const value_t &value, const value_t &id)
+        {
+            writer::write_result(output, value, id);
+        }
+
+        static void write_raw_result(std::string &output, const std::string_view &fragment, const value_t &id)
+        {
+            writer::write_raw_result(output, fragment, id);
+        }
+
+        static void write_error(std::string &output, const response_t &error)
+        {
+            writer::write_error(output, error);
+        }
+
+        static const std::string serialize_value(const value_t &value)
+        {
+            return writer::serialize_value(value);
+        }
+
+        static const std::string serialize_batch_request(const std::vector<request_t> &requests)
+        {
+            return writer::serialize_batch_request(requests);
+        }
+
+        static const std::string serialize_batch_response(const std::vector<response_t> &responses)
+        {
+            return writer::serialize_batch_response(responses);
+        }
+
+        static const std::string serialize_request(const request_t &request)
+        {
+            return writer::serialize_request(request);
+        }
+
+        static const std::string serialize_response(const response_t &response)
+        {
+            return writer::serialize_response(response);
+        }
+    };
+
+    struct msgpack_codec_t : single_codec_t<msgpack_codec_t, format_t::msgpack>
+    {
+        using batch_writer_t = msgpack::batch_writer_t;
+
+        static const bool is_batch(const std::string_view &str)
+        {
+            return msgpack::is_batch(str);
+        }
+
+        static const std::vector<std::string> get_batch(const std::string_view &str)
+        {
+            return msgpack::get_batch(str);
+        }
+
+        static const message_hint_t peek(const std::string_view &str)
+        {
+            return msgpack::peek(str);
+        }
+
+        static const request_t deserialize_request(const std::string_view &request_string, const param_lookup_t *lookup = nullptr)
+        {
+            return msgpack::deserialize_request(request_string, lookup);
+        }
+
+        static const response_t deserialize_response(const std::string_view &response_string)
+        {
+            return msgpack::deserialize_response(response_string);
+        }
+
+        static void write_result(std::string &output, const value_t &value, const value_t &id)
+        {
+            msgpack::write_result(output, value, id);
+        }
+
+        static void write_raw_result(std::string &output, const std::string_view &fragment, const value_t &id)
+        {
+            msgpack::write_raw_result(output, fragment, id);
+        }
+
+        static void write_error(std::string &output, const response_t &error)
+        {
+            msgpack::write_error(output, error);
+        }
+
+        static const std::string serialize_value(const value_t &value)
+        {
+            return msgpack::serialize_value(value);
+        }
+
+        static const std::string serialize_batch_request(const std::vector<request_t> &requests)
+        {
+            return msgpack::serialize_batch_request(requests);
+        }
+
+        static const std::string serialize_batch_response(const std::vector<response_t> &responses)
+        {
+            return msgpack::serialize_batch_response(responses);
+        }
+
+        static const std::string serialize_request(const request_t &request)
+        {
+            return msgpack::serialize_request(request);
+        }
+
+        static const std::string serialize_response(const response_t &response)
+        {
+            return msgpack::serialize_response(response);
+        }
+    };
+
+    //accepts json and messagepack, picking the format per message
+    struct auto_codec_t
+    {
+        static constexpr format_t default_format = format_t::json;
+
+        //json text starts with whitespace or a bracket, every messagepack map or array header has the high bit set
+        static const format_t detect_format(const std::string_view &str)
+        {
+            if (!str.empty() && (static_cast<uint8_t>(str.front()) & 0x80))
+                return format_t::msgpack;
+
+            return format_t::json;
+        }
+
+        template <typename visitor_type>
+        static decltype(auto) visit(const format_t &format, visitor_type &&visitor)
+        {
+            if (format == format_t::msgpack)
+                return visitor(msgpack_codec_t());
+
+            return visitor(json_codec_t());
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
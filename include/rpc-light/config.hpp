@@ -0,0 +1,22 @@
+#pragma once
+
+//compile time options, define them before including any rpc-light header.
+//
+//RPC_LIGHT_SIMD      lets rapidjson skip whitespace with the widest SIMD set the target enables
+//                    (SSE4.2, SSE2 or NEON, build with e.g. -msse4.2 or -march=native).
+//                    rapidjson has no AVX2 path, AVX2 targets use the SSE4.2 one.
+//                    rapidjson headers included before this one are not affected.
+//
+//RPC_LIGHT_SIMDJSON  parses requests and responses with simdjson's on-demand API instead of
+//                    rapidjson, building request_t and response_t directly from the input.
+//                    simdjson.h has to be on the include path.
+
+#ifdef RPC_LIGHT_SIMD
+#if defined(__SSE4_2__) && !defined(RAPIDJSON_SSE42)
+#define RAPIDJSON_SSE42
+#elif defined(__SSE2__) && !defined(RAPIDJSON_SSE2) && !defined(RAPIDJSON_SSE42)
+#define RAPIDJSON_SSE2
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(RAPIDJSON_NEON)
+#define RAPIDJSON_NEON
+#endif
+#endif
\ No newline at end of file
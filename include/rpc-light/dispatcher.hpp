@@ -5,58 +5,208 @@
 #include "value.hpp"
 #include "response.hpp"
 #include "request.hpp"
+#include "task.hpp"
+#include "cache.hpp"
+#include "coalesce.hpp"
+#include "epoch.hpp"
 
 #include <string>
 #include <functional>
 #include <vector>
 #include <unordered_map>
+#include <optional>
+#include <memory>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
 
 namespace rpc_light
 {
+    //named params of one method, compiled from its param mapping when the mapping is added.
+    //slots are sorted by name so an incoming object, which is ordered by name too, is matched in a single
+    //merged pass without lookups. members that are not params are skipped
+    class param_layout_t
+    {
+        struct slot_t
+        {
+            std::string name;
+            unsigned int index;
+            std::optional<value_t> fallback;
+        };
+
+        std::vector<slot_t> m_slots;
+
+    public:
+        param_layout_t(const param_map_t &mapping, const param_defaults_t &defaults = {})
+        {
+            m_slots.reserve(mapping.size());
+            for (auto &e : mapping)
+            {
+                if (e.first >= mapping.size())
+                    throw ex_bad_params("Params mapping indices are not contiguous.");
+
+                std::optional<value_t> fallback;
+                if (auto iter = defaults.find(e.first); iter != defaults.end())
+                    fallback.emplace(iter->second);
+
+                m_slots.push_back({e.second, e.first, std::move(fallback)});
+            }
 
-    class dispatcher_t
+            for (auto &e : defaults)
+                if (mapping.find(e.first) == mapping.end())
+                    throw ex_bad_params("Default for unmapped param.");
+
+            std::sort(m_slots.begin(), m_slots.end(), [](auto &a, auto &b) { return a.name < b.name; });
+            if (std::adjacent_find(m_slots.begin(), m_slots.end(), [](auto &a, auto &b) { return a.name == b.name; }) != m_slots.end())
+                throw ex_bad_params("Params mapping names are not unique.");
+        }
+
+        const array_t bind(const struct_t &params) const
+        {
+            array_t arr_params(m_slots.size());
+            auto param = params.begin(), params_end = params.end();
+            for (auto &e : m_slots)
+            {
+                while (param != params_end && param->first < e.name)
+                    ++param;
+
+                if (param != params_end && param->first == e.name)
+                    arr_params[e.index] = param->second;
+
+                else if (e.fallback)
+                    arr_params[e.index] = *e.fallback;
+
+                else
+                    throw ex_bad_params("Param not found.");
+            }
+            return arr_params;
+        }
+    };
+
+    //per-method behaviour chosen when the method is added
+    struct method_options_t
     {
-        std::unordered_map<std::string, method_t> m_methods;
-        std::unordered_map<std::string, param_map_t> m_mappings;
+        //the method is pure, its results are served from a cache keyed by params until they expire
+        bool idempotent = false;
+        cache_config_t cache;
+        //calls with the same params as one still running share its execution
+        bool coalesce = false;
+        //replace a method already bound under the name instead of raising ex_method_used
+        bool replace = false;
+        //scheduling lane of the method's calls and notifications. when unset calls run in the normal lane and
+        //notifications, which nobody waits for, in the low one
+        std::optional<priority_t> priority;
+    };
 
-        const array_t struct_params_to_arr(const std::string_view &name, const struct_t &params)
+    //methods may be added, replaced and removed while requests are dispatched. the method table is never
+    //changed in place, an update copies it, changes the copy and publishes it, and calls already running
+    //finish on the version they started with. readers take no lock, a version is freed once no call that
+    //could still see it is running. updates are serialized and cost a copy of the table
+    class dispatcher_t : public param_lookup_t
+    {
+#ifdef RPC_LIGHT_COROUTINES
+        using async_method_t = std::function<task_t<value_t>(const array_t &)>;
+#endif
+
+        //caches and flight groups are shared by the versions of the table that contain their method
+        struct method_table_t
         {
-            if (auto method_iter = m_mappings.find(name.data()); method_iter != m_mappings.end())
+            std::unordered_map<std::string, method_t> methods;
+            std::unordered_map<std::string, param_layout_t> mappings;
+            std::unordered_map<std::string, std::shared_ptr<result_cache_t>> caches;
+            std::unordered_map<std::string, std::shared_ptr<flight_group_t>> flights;
+            std::unordered_map<std::string, priority_t> priorities;
+            //decoders of the methods with params of reflected types, they are static and outlive every version
+            std::unordered_map<std::string, const param_decoders_t *> decoders;
+#ifdef RPC_LIGHT_COROUTINES
+            std::unordered_map<std::string, async_method_t> async_methods;
+#endif
+
+            const bool is_bound(const std::string &name) const
             {
-                array_t arr_params;
-                auto params_size = params.size();
-                arr_params.reserve(params_size);
-                for (auto i = 0; i < params_size; i++)
-                {
-                    if (auto index_iter = method_iter->second.find(i); index_iter != method_iter->second.end())
-                    {
-                        if (auto params_iter = params.find(index_iter->second); params_iter != params.end())
-                        {
-                            arr_params.emplace_back(params_iter->second);
-                        }
-                        else
-                        {
-                            throw ex_internal_error("Param not found.");
-                        }
-                    }
-                    else
-                    {
-                        throw ex_internal_error("Index not found.");
-                    }
-                }
-                return arr_params;
+#ifdef RPC_LIGHT_COROUTINES
+                if (async_methods.find(name) != async_methods.end())
+                    return true;
+#endif
+                return methods.find(name) != methods.end();
+            }
+        };
+
+        std::atomic<const method_table_t *> m_table;
+        std::mutex m_update;
+        //replaced versions with the epoch after which they are no longer read
+        std::vector<std::pair<uint64_t, const method_table_t *>> m_retired;
+
+        //only valid while the caller holds a read guard
+        const inline method_table_t &table() const
+        {
+            return *m_table.load(std::memory_order_seq_cst);
+        }
+
+        template <typename modify_type>
+        void update(const modify_type &modify)
+        {
+            std::unique_lock<std::mutex> lock(m_update);
+            auto next = std::make_unique<method_table_t>(*m_table.load(std::memory_order_relaxed));
+            modify(*next);
+
+            auto &domain = epoch_domain_t::instance();
+            auto previous = m_table.exchange(next.release(), std::memory_order_seq_cst);
+            m_retired.emplace_back(domain.advance(), previous);
+
+            //versions are retired in epoch order, so the free ones are at the front
+            auto iter = m_retired.begin();
+            for (; iter != m_retired.end() && domain.safe(iter->first); ++iter)
+                delete iter->second;
+
+            m_retired.erase(m_retired.begin(), iter);
+        }
+
+        template <typename param_type>
+        static constexpr param_decoder_t decoder_of()
+        {
+            if constexpr (is_reflected_v<param_type>)
+                return &decode_param<param_type>;
+
+            else
+                return nullptr;
+        }
+
+        //one list per signature, null when none of the params is reflected
+        template <typename... params_type>
+        static const param_decoders_t *decoders_of()
+        {
+            if constexpr ((is_reflected_v<std::decay_t<params_type>> || ...))
+            {
+                static const param_decoders_t decoders = {decoder_of<std::decay_t<params_type>>()...};
+                return &decoders;
             }
+            else
+                return nullptr;
+        }
+
+        static const array_t struct_params_to_arr(const method_table_t &table, const std::string &name, const struct_t &params)
+        {
+            if (auto iter = table.mappings.find(name); iter != table.mappings.end())
+                return iter->second.bind(params);
+
             throw ex_internal_error("Params mapping not found.");
         }
 
         template <typename return_type, typename... params_type>
-        void add_method_internal(const std::string_view &name, const std::function<return_type(params_type...)> &method)
+        void add_method_internal(const std::string_view &name, const std::function<return_type(params_type...)> &method, const method_options_t &options)
         {
-            add_method_internal(name, method, std::index_sequence_for<params_type...>());
+#ifdef RPC_LIGHT_COROUTINES
+            if constexpr (is_task<return_type>::value)
+                add_async_method_internal(name, method, options, std::index_sequence_for<params_type...>());
+            else
+#endif
+                add_method_internal(name, method, options, std::index_sequence_for<params_type...>());
         }
 
         template <typename return_type, typename... params_type, std::size_t... index>
-        void add_method_internal(const std::string_view &name, const std::function<return_type(params_type...)> &method, const std::index_sequence<index...>)
+        void add_method_internal(const std::string_view &name, const std::function<return_type(params_type...)> &method, const method_options_t &options, const std::index_sequence<index...>)
         {
             method_t expr = [method](const array_t &params) -> value_t {
                 constexpr auto params_size = sizeof...(params_type);
@@ -89,91 +239,338 @@ namespace rpc_light
                     throw ex_bad_params("Invalid param types.");
                 }
             };
-            add_method(name, expr);
+            bind_method(name, expr, options, decoders_of<params_type...>());
+        }
+
+#ifdef RPC_LIGHT_COROUTINES
+        //the method is copied into the coroutine frame so it outlives the registration it was called through
+        template <typename return_type, typename... params_type, std::size_t... index>
+        static task_t<value_t> call_async(const std::function<return_type(params_type...)> method, const array_t params, const std::index_sequence<index...>)
+        {
+            if (sizeof...(params_type) != params.size())
+                throw ex_bad_params("Params length mismatch.");
+
+            std::optional<return_type> task;
+            try
+            {
+                task.emplace(method(params[index].template get_value<std::decay_t<params_type>>()...));
+            }
+            catch (...)
+            {
+                throw ex_bad_params("Invalid param types.");
+            }
+
+            if constexpr (std::is_void_v<decltype(std::declval<return_type &>().await_resume())>)
+            {
+                co_await std::move(*task);
+                co_return null_t();
+            }
+            else
+                co_return value_t(co_await std::move(*task));
+        }
+
+        template <typename return_type, typename... params_type, std::size_t... index>
+        void add_async_method_internal(const std::string_view &name, const std::function<return_type(params_type...)> &method, const method_options_t &options, const std::index_sequence<index...> sequence)
+        {
+            static_assert(!std::disjunction_v<std::is_reference<params_type>...>,
+                          "Coroutine methods must take their params by value.");
+
+            if (options.idempotent || options.coalesce)
+                throw ex_internal_error("Coroutine methods are not cached or coalesced.");
+
+            async_method_t async_method = [method, sequence](const array_t &params) {
+                return call_async(method, params, sequence);
+            };
+            update([&](method_table_t &table) {
+                std::string key(name);
+                if (table.is_bound(key) && !options.replace)
+                    throw ex_method_used("Method already bound.");
+
+                table.methods.erase(key);
+                table.caches.erase(key);
+                table.flights.erase(key);
+                table.priorities.erase(key);
+                table.decoders.erase(key);
+                table.async_methods.insert_or_assign(key, async_method);
+                if (options.priority)
+                    table.priorities.emplace(key, *options.priority);
+
+                if (auto decoders = decoders_of<params_type...>())
+                    table.decoders.emplace(key, decoders);
+            });
+        }
+#endif
+
+        void bind_method(const std::string_view &name, const method_t &method, const method_options_t &options, const param_decoders_t *decoders)
+        {
+            auto cache = options.idempotent ? std::make_shared<result_cache_t>(options.cache) : nullptr;
+            auto flights = options.coalesce ? std::make_shared<flight_group_t>() : nullptr;
+            update([&](method_table_t &table) {
+                std::string key(name);
+                if (table.is_bound(key) && !options.replace)
+                    throw ex_method_used("Method already bound.");
+
+#ifdef RPC_LIGHT_COROUTINES
+                table.async_methods.erase(key);
+#endif
+                table.methods.insert_or_assign(key, method);
+                table.caches.erase(key);
+                table.flights.erase(key);
+                table.priorities.erase(key);
+                table.decoders.erase(key);
+                if (options.priority)
+                    table.priorities.emplace(key, *options.priority);
+
+                if (cache)
+                    table.caches.emplace(key, cache);
+
+                if (flights)
+                    table.flights.emplace(key, flights);
+
+                if (decoders)
+                    table.decoders.emplace(key, decoders);
+            });
         }
 
     public:
-        dispatcher_t() {}
+        dispatcher_t() : m_table(new method_table_t()) {}
+
+        //copies the method table and param mappings, the bound methods themselves are shared.
+        //caches and flight groups are not, the copy starts with empty ones configured like the original
+        dispatcher_t(const dispatcher_t &other)
+        {
+            auto guard = other.read();
+            auto table = std::make_unique<method_table_t>(other.table());
+            for (auto &e : table->caches)
+                e.second = std::make_shared<result_cache_t>(e.second->config());
+
+            for (auto &e : table->flights)
+                e.second = std::make_shared<flight_group_t>();
+
+            m_table.store(table.release());
+        }
+
+        dispatcher_t &operator=(const dispatcher_t &) = delete;
+
+        //every call into the dispatcher must have returned before it is destroyed
+        ~dispatcher_t()
+        {
+            delete m_table.load();
+            for (auto &e : m_retired)
+                delete e.second;
+        }
+
+        //keeps the current version of the method table alive, and with it the pointers returned by get_cache
+        //and get_flight_group, until the guard is destroyed. guards are cheap and nest
+        epoch_domain_t::guard_t read() const
+        {
+            return epoch_domain_t::guard_t(epoch_domain_t::instance());
+        }
 
         template <typename method_type>
-        void add_method(const std::string_view &name, const method_type &method)
+        void add_method(const std::string_view &name, const method_type &method, const method_options_t &options = {})
         {
-            add_method_internal(name, std::function(method));
+            add_method_internal(name, std::function(method), options);
         }
 
         template <typename instance_type>
-        void add_method(const std::string_view &name, value_t (instance_type::*method)(const array_t &), instance_type &instance)
+        void add_method(const std::string_view &name, value_t (instance_type::*method)(const array_t &), instance_type &instance, const method_options_t &options = {})
         {
-            add_method(name, std::bind(method, &instance, std::placeholders::_1));
+            add_method(name, std::bind(method, &instance, std::placeholders::_1), options);
         }
 
         template <typename instance_type>
-        void add_method(const std::string_view &name, value_t (instance_type::*method)(const array_t &) const, instance_type &instance)
+        void add_method(const std::string_view &name, value_t (instance_type::*method)(const array_t &) const, instance_type &instance, const method_options_t &options = {})
         {
-            add_method(name, std::bind(method, &instance, std::placeholders::_1));
+            add_method(name, std::bind(method, &instance, std::placeholders::_1), options);
         }
 
         template <typename return_type, typename instance_type, typename... params_type>
-        void add_method(const std::string_view &name, return_type (instance_type::*method)(params_type...), instance_type &instance)
+        void add_method(const std::string_view &name, return_type (instance_type::*method)(params_type...), instance_type &instance, const method_options_t &options = {})
         {
             std::function<return_type(params_type...)> std_fn = [&instance, method](params_type &&... params) -> return_type {
                 return (instance.*method)(std::forward<params_type>(params)...);
             };
-            add_method_internal(name, std_fn);
+            add_method_internal(name, std_fn, options);
         }
 
         template <typename return_type, typename instance_type, typename... params_type>
-        void add_method(const std::string_view &name, return_type (instance_type::*method)(params_type...) const, instance_type &instance)
+        void add_method(const std::string_view &name, return_type (instance_type::*method)(params_type...) const, instance_type &instance, const method_options_t &options = {})
         {
             std::function<return_type(params_type...)> std_fn = [&instance, method](params_type &&... params) -> return_type {
                 return (instance.*method)(std::forward<params_type>(params)...);
             };
-            add_method_internal(name, std_fn);
+            add_method_internal(name, std_fn, options);
+        }
+
+        //with options.replace an existing method of the same name is replaced, its param mapping is kept and
+        //its cache and flight group are replaced as well. calls already running finish with the old method
+        void add_method(const std::string_view &name, const method_t &method, const method_options_t &options = {})
+        {
+            bind_method(name, method, options, nullptr);
+        }
+
+        //removes the method together with its param mapping, returns false when it was not bound.
+        //calls already running finish, later ones fail with method not found
+        bool remove_method(const std::string_view &name)
+        {
+            bool removed = false;
+            update([&](method_table_t &table) {
+                std::string key(name);
+                removed = table.methods.erase(key) > 0;
+#ifdef RPC_LIGHT_COROUTINES
+                removed = table.async_methods.erase(key) > 0 || removed;
+#endif
+                table.mappings.erase(key);
+                table.caches.erase(key);
+                table.flights.erase(key);
+                table.priorities.erase(key);
+                table.decoders.erase(key);
+            });
+            return removed;
         }
 
-        void add_method(const std::string_view &name, const method_t &method)
+        const bool is_bound(const std::string &name) const
         {
-            if (m_methods.find(name.data()) != m_methods.end())
-                throw ex_method_used("Method already bound.");
+            auto guard = read();
+            return table().is_bound(name);
+        }
+
+        //the result cache of an idempotent method, null for any other method. the caller holds a read guard
+        result_cache_t *get_cache(const std::string &name) const
+        {
+            auto &caches = table().caches;
+            if (caches.empty())
+                return nullptr;
+
+            if (auto iter = caches.find(name); iter != caches.end())
+                return iter->second.get();
 
-            m_methods.emplace(name, method);
+            return nullptr;
         }
 
-        void add_param_mapping(const std::string_view &name, const param_map_t &mapping)
+        //the in-flight calls of a coalesced method, null for any other method. the caller holds a read guard
+        flight_group_t *get_flight_group(const std::string &name) const
         {
-            if (m_mappings.find(name.data()) != m_mappings.end())
-                throw ex_method_used("Method params mapping already bound.");
+            auto &flights = table().flights;
+            if (flights.empty())
+                return nullptr;
 
-            m_mappings.emplace(name, mapping);
+            if (auto iter = flights.find(name); iter != flights.end())
+                return iter->second.get();
+
+            return nullptr;
         }
 
-        const response_t invoke(const request_t &request)
+        //the priority the method was added with, if any
+        const std::optional<priority_t> get_priority(const std::string_view &name) const
         {
-            if (auto iter = m_methods.find(request.get_method()); iter != m_methods.end())
+            auto guard = read();
+            auto &priorities = table().priorities;
+            if (priorities.empty())
+                return std::nullopt;
+
+            if (auto iter = priorities.find(std::string(name)); iter != priorities.end())
+                return iter->second;
+
+            return std::nullopt;
+        }
+
+        //lets readers decode the positional params of reflected types straight into object_t, see param_lookup_t
+        const param_decoders_t *find_decoders(const std::string &method) const override
+        {
+            auto guard = read();
+            auto &decoders = table().decoders;
+            if (decoders.empty())
+                return nullptr;
+
+            if (auto iter = decoders.find(method); iter != decoders.end())
+                return iter->second;
+
+            return nullptr;
+        }
+
+        //params in defaults are optional, the client may leave them out of a named params object
+        void add_param_mapping(const std::string_view &name, const param_map_t &mapping, const param_defaults_t &defaults = {})
+        {
+            param_layout_t layout(mapping, defaults);
+            update([&](method_table_t &table) {
+                if (!table.mappings.emplace(name, layout).second)
+                    throw ex_method_used("Method params mapping already bound.");
+            });
+        }
+
+        //runs the bound method and returns its value without wrapping it in a response
+        const value_t call(const request_t &request)
+        {
+            auto guard = read();
+            auto &table = this->table();
+            if (auto iter = table.methods.find(request.get_method()); iter != table.methods.end())
             {
-                if (request.is_notification())
-                {
+                auto &method = iter->second;
+                auto run = [&]() -> value_t {
                     if (!request.has_params())
-                        return response_t(iter->second(array_t()));
+                        return method(array_t());
 
                     if (!request.has_named_params())
-                        return response_t(iter->second(request.get_params_arr()));
+                        return method(request.get_params_arr());
 
-                    return response_t(iter->second(struct_params_to_arr(request.get_method(), request.get_params_str())));
-                }
-                else
-                {
-                    if (!request.has_params())
-                        return response_t(iter->second(array_t()), request.get_id());
+                    return method(struct_params_to_arr(table, request.get_method(), request.get_params_str()));
+                };
 
-                    if (!request.has_named_params())
-                        return response_t(iter->second(request.get_params_arr()), request.get_id());
+                if (auto flights = get_flight_group(request.get_method()))
+                    return flights->call(request, run);
 
-                    return response_t(iter->second(struct_params_to_arr(request.get_method(), request.get_params_str())), request.get_id());
-                }
+                return run();
             }
 
             throw ex_bad_method("Method not bound.");
         }
+
+        //runs the bound method and discards its value, for messages nobody waits on
+        void notify(const request_t &request)
+        {
+            call(request);
+        }
+
+        const response_t invoke(const request_t &request)
+        {
+            if (request.is_notification())
+                return response_t(call(request));
+
+            return response_t(call(request), request.get_id());
+        }
+
+#ifdef RPC_LIGHT_COROUTINES
+        const inline bool is_async(const std::string &name) const
+        {
+            auto guard = read();
+            auto &async_methods = table().async_methods;
+            return async_methods.find(name) != async_methods.end();
+        }
+
+        //the returned task starts when awaited and completes when the bound coroutine does.
+        //the method is copied into the coroutine frame, so the table is only read until the task is created
+        task_t<response_t> invoke_async(const request_t request)
+        {
+            std::optional<task_t<value_t>> task;
+            {
+                auto guard = read();
+                auto &table = this->table();
+                auto iter = table.async_methods.find(request.get_method());
+                if (iter == table.async_methods.end())
+                    throw ex_bad_method("Method not bound.");
+
+                task.emplace(!request.has_params()         ? iter->second(array_t())
+                             : !request.has_named_params() ? iter->second(request.get_params_arr())
+                                                           : iter->second(struct_params_to_arr(table, request.get_method(), request.get_params_str())));
+            }
+            auto value = co_await std::move(*task);
+            if (request.is_notification())
+                co_return response_t(value);
+
+            co_return response_t(value, request.get_id());
+        }
+#endif
     };
 } // namespace rpc_light
\ No newline at end of file
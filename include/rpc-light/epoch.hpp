@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace rpc_light
+{
+    //epoch based reclamation for data that is read far more often than it is replaced. a reader announces
+    //the epoch it started in for the length of a guard_t, a writer publishes a new version, advances the
+    //epoch and frees the old version once no reader is still in an earlier epoch. readers never wait or
+    //lock, they only store to a slot owned by their thread
+    class epoch_domain_t
+    {
+        struct alignas(64) slot_t
+        {
+            //epoch the owning thread entered its outermost guard in, 0 outside of any guard
+            std::atomic<uint64_t> epoch{0};
+            std::atomic<bool> used{true};
+            unsigned int depth = 0;
+            slot_t *next = nullptr;
+        };
+
+        //releases the thread's slot for reuse when the thread exits
+        struct holder_t
+        {
+            slot_t *slot = nullptr;
+
+            ~holder_t()
+            {
+                if (slot)
+                    slot->used.store(false, std::memory_order_release);
+            }
+        };
+
+        std::atomic<slot_t *> m_slots{nullptr};
+        std::atomic<uint64_t> m_epoch{1};
+
+        epoch_domain_t() {}
+
+        slot_t *acquire_slot()
+        {
+            for (auto slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+                if (bool used = false; !slot->used.load(std::memory_order_relaxed) && slot->used.compare_exchange_strong(used, true))
+                    return slot;
+
+            auto slot = new slot_t();
+            slot->next = m_slots.load(std::memory_order_relaxed);
+            while (!m_slots.compare_exchange_weak(slot->next, slot, std::memory_order_release, std::memory_order_relaxed))
+                ;
+            return slot;
+        }
+
+        slot_t &local_slot()
+        {
+            static thread_local holder_t t_holder;
+            if (!t_holder.slot)
+                t_holder.slot = acquire_slot();
+
+            return *t_holder.slot;
+        }
+
+    public:
+        epoch_domain_t(const epoch_domain_t &) = delete;
+        epoch_domain_t &operator=(const epoch_domain_t &) = delete;
+
+        ~epoch_domain_t()
+        {
+            for (auto slot = m_slots.load(); slot;)
+                delete std::exchange(slot, slot->next);
+        }
+
+        //one domain serves every reader in the process, a thread holds a single slot however many structures it reads
+        static epoch_domain_t &instance()
+        {
+            static epoch_domain_t domain;
+            return domain;
+        }
+
+        //guards nest, only the outermost one announces and clears the epoch
+        class guard_t
+        {
+            slot_t &m_slot;
+
+        public:
+            guard_t(epoch_domain_t &domain) : m_slot(domain.local_slot())
+            {
+                if (m_slot.depth++ == 0)
+                    //pairs with the seq_cst publish and advance of the writer, which either sees this epoch
+                    //or published before it and is not read by this guard
+                    m_slot.epoch.store(domain.m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            }
+
+            guard_t(const guard_t &) = delete;
+            guard_t &operator=(const guard_t &) = delete;
+
+            ~guard_t()
+            {
+                if (--m_slot.depth == 0)
+                    m_slot.epoch.store(0, std::memory_order_release);
+            }
+        };
+
+        //called after publishing a new version, the old one may be freed once safe(epoch) holds for the result
+        uint64_t advance()
+        {
+            return m_epoch.fetch_add(1, std::memory_order_seq_cst) + 1;
+        }
+
+        //no reader entered before epoch is still inside its guard
+        const bool safe(const uint64_t &epoch) const
+        {
+            for (auto slot = m_slots.load(std::memory_order_acquire); slot; slot = slot->next)
+                if (auto current = slot->epoch.load(std::memory_order_seq_cst); current != 0 && current < epoch)
+                    return false;
+
+            return true;
+        }
+    };
+} // namespace rpc_light
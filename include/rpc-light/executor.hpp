@@ -0,0 +1,502 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "queue.hpp"
+#include "task.hpp"
+#include "numa.hpp"
+#include "aliases.hpp"
+
+#include <functional>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <limits>
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace rpc_light
+{
+    struct executor_config_t
+    {
+        //number of long-lived worker threads, bound methods must be thread safe when this is above 1
+        unsigned int threads = 1;
+        //number of empty polls a worker spins through before parking on the condition variable
+        unsigned int spin_count = 4096;
+        //capacity of each lane's hand-off ring, other threads yield while it is full and a worker keeps the
+        //work on its own stack instead, as it would wait on itself
+        std::size_t queue_capacity = 4096;
+        //turns each priority lane gets in a round, indexed by priority_t. a worker takes from the lane whose
+        //turn it is, its own queued work counting as the normal lane, or from the first non-empty lane in
+        //priority order when that one is empty, so lower lanes are never starved while they still yield to
+        //higher ones under load
+        std::vector<unsigned int> lane_weights = {8, 4, 1};
+        //optional cpu index per worker, workers past the end of the list are not pinned.
+        //see numa::spread_affinity and numa::node_affinity to place workers by numa node
+        std::vector<int> cpu_affinity;
+        //work posted from outside the pool goes to a worker on the posting thread's numa node instead of
+        //the shared ring, so a request is parsed and run on the node whose memory received it.
+        //only pinned workers have a node, with none on the posting thread's node the shared ring is used
+        bool numa_local = false;
+    };
+
+    class executor_t
+    {
+        using work_t = std::function<void()>;
+
+        //each worker owns an inbox and a stack. work handed to the worker from another thread, like the
+        //requests of one connection, waits in the inbox and runs in the order it was posted. work the worker
+        //posts itself goes on the stack and runs newest first while its data is still warm. the inbox is
+        //drained first so spawned work cannot hold back posted work, thieves take the oldest item of either
+        struct worker_t
+        {
+            std::mutex mutex;
+            std::deque<work_t> inbox;
+            std::deque<work_t> stack;
+            //items in inbox and stack, read without the lock so idle workers skip empty victims
+            std::atomic<std::size_t> size{0};
+            //numa node of the cpu the worker is pinned to, -1 when unpinned
+            int node = -1;
+            //position in the lane schedule, only used by the owner
+            std::size_t turn = 0;
+        };
+
+        static constexpr std::size_t LANES = 3;
+
+        static inline thread_local executor_t *t_executor = nullptr;
+        static inline thread_local std::size_t t_index = 0;
+
+        executor_config_t m_config;
+        std::vector<std::thread> m_threads;
+        std::vector<std::unique_ptr<worker_t>> m_workers;
+        //submissions from threads outside the pool and prioritized work, one ring per priority_t
+        std::vector<std::unique_ptr<mpmc_queue_t<work_t>>> m_lanes;
+        //lane order of one round, the weights interleaved so no lane waits a whole round
+        std::vector<std::size_t> m_schedule;
+        //only used to park idle workers, the queues themselves are not locked by producers
+        std::mutex m_mutex;
+        std::condition_variable m_event;
+        std::atomic<unsigned int> m_parked{0};
+        std::atomic<bool> m_running{false};
+        //threads outside the pool in the middle of a post, stopping workers wait for their work to land
+        std::atomic<unsigned int> m_posting{0};
+        //worker indices by numa node, empty unless workers are pinned to more than one node or numa_local is set
+        std::vector<std::pair<int, std::vector<std::size_t>>> m_nodes;
+
+        void pin_thread(std::thread &thread, const int &cpu)
+        {
+#ifdef __linux__
+            cpu_set_t cpu_set;
+            CPU_ZERO(&cpu_set);
+            CPU_SET(cpu, &cpu_set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(cpu_set_t), &cpu_set);
+#endif
+        }
+
+        //spawned work goes on the worker's stack, anything else into its inbox
+        void push_local(const std::size_t &index, work_t &&work, const bool &spawned)
+        {
+            auto &worker = *m_workers[index];
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            (spawned ? worker.stack : worker.inbox).push_back(std::move(work));
+            worker.size.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        bool take(worker_t &worker, const bool &owner, work_t &work)
+        {
+            if (worker.size.load(std::memory_order_relaxed) == 0)
+                return false;
+
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            if (!worker.inbox.empty())
+            {
+                work = std::move(worker.inbox.front());
+                worker.inbox.pop_front();
+            }
+            else if (worker.stack.empty())
+                return false;
+
+            else if (owner)
+            {
+                work = std::move(worker.stack.back());
+                worker.stack.pop_back();
+            }
+            else
+            {
+                work = std::move(worker.stack.front());
+                worker.stack.pop_front();
+            }
+
+            worker.size.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        bool pop_local(const std::size_t &index, work_t &work)
+        {
+            return take(*m_workers[index], true, work);
+        }
+
+        bool steal_from(const std::size_t &victim, work_t &work)
+        {
+            return take(*m_workers[victim], false, work);
+        }
+
+        //workers on the thief's own numa node are tried first, remote work is only taken when they are all idle
+        bool steal(const std::size_t &index, work_t &work)
+        {
+            auto size = m_workers.size();
+            auto node = m_workers[index]->node;
+            if (!m_nodes.empty() && node >= 0)
+            {
+                for (std::size_t i = 1; i <= size; i++)
+                    if (auto victim = (index + i) % size; m_workers[victim]->node == node && steal_from(victim, work))
+                        return true;
+
+                for (std::size_t i = 1; i <= size; i++)
+                    if (auto victim = (index + i) % size; m_workers[victim]->node != node && steal_from(victim, work))
+                        return true;
+
+                return false;
+            }
+
+            for (std::size_t i = 1; i <= size; i++)
+                if (steal_from((index + i) % size, work))
+                    return true;
+
+            return false;
+        }
+
+        //a worker on the calling thread's node, rotating between them per posting thread
+        bool near_worker(std::size_t &index) const
+        {
+            static thread_local std::size_t t_next = 0;
+            auto node = numa::current_node();
+            for (auto &e : m_nodes)
+                if (e.first == node)
+                {
+                    index = e.second[t_next++ % e.second.size()];
+                    return true;
+                }
+
+            return false;
+        }
+
+        //the worker's own work is normal work and takes the normal lane's turns, so a backlog of it cannot
+        //hold back the high lane and the lanes keep their weights whether normal work was queued locally or not
+        bool try_get(const std::size_t &index, const bool &is_worker, work_t &work)
+        {
+            static constexpr auto NORMAL = static_cast<std::size_t>(priority_t::normal);
+            auto lane = m_schedule[m_workers[index]->turn++ % m_schedule.size()];
+            if (lane == NORMAL && is_worker && pop_local(index, work))
+                return true;
+
+            if (m_lanes[lane]->try_pop(work))
+                return true;
+
+            //the scheduled lane is empty, the first lane in priority order that is not
+            for (std::size_t i = 0; i < LANES; i++)
+            {
+                if (i == NORMAL && is_worker && pop_local(index, work))
+                    return true;
+
+                if (m_lanes[i]->try_pop(work))
+                    return true;
+            }
+
+            return steal(index, work);
+        }
+
+        //smooth weighted round robin over the lanes, without weights the lanes are strictly ordered
+        void build_schedule()
+        {
+            std::vector<long> weights(LANES, 0), current(LANES, 0);
+            long total = 0;
+            for (std::size_t i = 0; i < LANES && i < m_config.lane_weights.size(); i++)
+                total += weights[i] = m_config.lane_weights[i];
+
+            for (long turn = 0; turn < total; turn++)
+            {
+                std::size_t next = 0;
+                for (std::size_t i = 0; i < LANES; i++)
+                {
+                    current[i] += weights[i];
+                    if (current[i] > current[next])
+                        next = i;
+                }
+                current[next] -= total;
+                m_schedule.push_back(next);
+            }
+
+            if (m_schedule.empty())
+                m_schedule.push_back(0);
+        }
+
+        void wake()
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_parked.load(std::memory_order_relaxed) > 0)
+            {
+                //taking the lock orders the notify after a parking worker has started waiting
+                std::unique_lock<std::mutex> lock(m_mutex);
+                lock.unlock();
+                m_event.notify_one();
+            }
+        }
+
+        //work posted from outside the pool is counted while it is pushed, false when no worker would run it
+        bool begin_post()
+        {
+            if (on_worker())
+                return true;
+
+            m_posting.fetch_add(1);
+            if (m_running)
+                return true;
+
+            end_post();
+            return false;
+        }
+
+        void end_post()
+        {
+            if (on_worker())
+                return;
+
+            m_posting.fetch_sub(1);
+            if (!m_running)
+            {
+                //workers draining for stop park until no post is in flight, every one of them must recheck
+                std::unique_lock<std::mutex> lock(m_mutex);
+                lock.unlock();
+                m_event.notify_all();
+            }
+        }
+
+        //joins every worker but the calling one, which keeps its thread until the next stop or start
+        void join()
+        {
+            auto self = std::this_thread::get_id();
+            for (auto &e : m_threads)
+                if (e.joinable() && e.get_id() != self)
+                    e.join();
+
+            m_threads.erase(std::remove_if(m_threads.begin(), m_threads.end(), [](auto &e) { return !e.joinable(); }), m_threads.end());
+        }
+
+        void worker_proc(const std::size_t index)
+        {
+            t_executor = this;
+            t_index = index;
+            work_t work;
+            while (true)
+            {
+                for (unsigned int spins = 0; spins < m_config.spin_count; spins++)
+                {
+                    if (try_get(index, true, work))
+                        break;
+
+                    std::this_thread::yield();
+                }
+
+                if (!work)
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_parked.fetch_add(1);
+                    //pairs with the fence in wake so either the producer sees a parked worker or the worker sees the work
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    m_event.wait(lock, [&] { return try_get(index, true, work) || (!m_running && m_posting == 0); });
+                    m_parked.fetch_sub(1);
+                    if (!work)
+                        break;
+                }
+
+                work();
+                work = nullptr;
+            }
+            t_executor = nullptr;
+        }
+
+    public:
+        executor_t(const executor_config_t &config = executor_config_t())
+            : m_config(config)
+        {
+            if (m_config.threads == 0)
+                m_config.threads = 1;
+
+            for (std::size_t i = 0; i < LANES; i++)
+                m_lanes.emplace_back(std::make_unique<mpmc_queue_t<work_t>>(m_config.queue_capacity));
+
+            build_schedule();
+
+            m_workers.reserve(m_config.threads);
+            for (unsigned int i = 0; i < m_config.threads; i++)
+            {
+                auto &worker = *m_workers.emplace_back(std::make_unique<worker_t>());
+                if (i < m_config.cpu_affinity.size())
+                    worker.node = numa::node_of_cpu(m_config.cpu_affinity[i]);
+
+                if (worker.node < 0)
+                    continue;
+
+                auto iter = std::find_if(m_nodes.begin(), m_nodes.end(), [&](auto &e) { return e.first == worker.node; });
+                if (iter == m_nodes.end())
+                    iter = m_nodes.insert(m_nodes.end(), {worker.node, {}});
+
+                iter->second.push_back(i);
+            }
+
+            //with every worker on one node placement has nothing to choose between
+            if (m_nodes.size() < 2 && !m_config.numa_local)
+                m_nodes.clear();
+        }
+
+        executor_t(const executor_t &) = delete;
+        executor_t &operator=(const executor_t &) = delete;
+
+        //a worker destroying its own executor cannot join itself, its thread is detached
+        ~executor_t()
+        {
+            stop();
+            join();
+            for (auto &e : m_threads)
+                e.detach();
+        }
+
+        void start()
+        {
+            //a worker that stopped the pool may still be finishing, it needs the lock to exit
+            if (!m_running)
+                join();
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            if (m_running)
+                return;
+
+            m_running = true;
+            m_threads.reserve(m_config.threads);
+            for (std::size_t i = 0; i < m_config.threads; i++)
+            {
+                auto &thread = m_threads.emplace_back(&executor_t::worker_proc, this, i);
+                if (i < m_config.cpu_affinity.size())
+                    pin_thread(thread, m_config.cpu_affinity[i]);
+            }
+        }
+
+        //queued work is drained before the workers exit, work posted from outside the pool afterwards runs on
+        //the posting thread. called from a worker, e.g. by a method stopping its server, the other workers are
+        //joined and the calling one exits once its work returns
+        void stop()
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                if (!m_running)
+                    return;
+
+                m_running = false;
+            }
+            m_event.notify_all();
+            join();
+        }
+
+        const inline bool is_running() const
+        {
+            return m_running;
+        }
+
+        const inline std::size_t concurrency() const
+        {
+            return m_workers.size();
+        }
+
+        const inline bool on_worker() const
+        {
+            return t_executor == this;
+        }
+
+        //numa node the worker is pinned to, -1 when it is not pinned
+        const inline int worker_node(const std::size_t &worker) const
+        {
+            return m_workers.at(worker)->node;
+        }
+
+        //normal work posted from a worker stays on that worker's stack until it is stolen,
+        //work posted from any other thread and work of other priorities goes through the lane's ring.
+        //when the pool is not running the work runs on the calling thread before post returns
+        void post(const priority_t &priority, work_t work)
+        {
+            if (!begin_post())
+                return work();
+
+            std::size_t index;
+            if (priority == priority_t::normal && on_worker())
+                push_local(t_index, std::move(work), true);
+
+            else if (priority == priority_t::normal && m_config.numa_local && near_worker(index))
+                push_local(index, std::move(work), false);
+
+            else
+            {
+                auto &lane = *m_lanes[static_cast<std::size_t>(priority)];
+                while (!lane.try_push(std::move(work)))
+                {
+                    //a worker waiting for room in a ring only it may be draining never returns
+                    if (on_worker())
+                    {
+                        push_local(t_index, std::move(work), true);
+                        break;
+                    }
+
+                    std::this_thread::yield();
+                }
+            }
+
+            end_post();
+            wake();
+        }
+
+        void post(work_t work)
+        {
+            post(priority_t::normal, std::move(work));
+        }
+
+        //lets a transport keep a connection's work on one worker, it runs in the order it was posted unless
+        //an idle worker steals some of it
+        void post(const std::size_t &worker, work_t work)
+        {
+            if (!begin_post())
+                return work();
+
+            push_local(worker % m_workers.size(), std::move(work), false);
+            end_post();
+            wake();
+        }
+
+#ifdef RPC_LIGHT_COROUTINES
+        //co_await schedule() resumes the awaiting coroutine on one of the workers
+        auto schedule()
+        {
+            struct schedule_awaiter_t
+            {
+                executor_t &executor;
+
+                bool await_ready() const noexcept { return false; }
+
+                void await_suspend(const std::coroutine_handle<> &handle)
+                {
+                    executor.post([handle] { handle.resume(); });
+                }
+
+                void await_resume() const noexcept {}
+            };
+            return schedule_awaiter_t{*this};
+        }
+#endif
+    };
+} // namespace rpc_light
\ No newline at end of file
@@ -0,0 +1,1122 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "request.hpp"
+#include "response.hpp"
+#include "reader.hpp"
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <optional>
+#include <type_traits>
+#include <cstring>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //messagepack encoding of the same request, response and batch structure the json reader and writer use,
+    //objects become maps keyed by the usual member names, batches become arrays and blobs become bin
+    namespace msgpack
+    {
+        constexpr uint8_t
+            MP_NIL = 0xc0,
+            MP_FALSE = 0xc2,
+            MP_TRUE = 0xc3,
+            MP_BIN8 = 0xc4,
+            MP_BIN16 = 0xc5,
+            MP_BIN32 = 0xc6,
+            MP_EXT8 = 0xc7,
+            MP_EXT16 = 0xc8,
+            MP_EXT32 = 0xc9,
+            MP_FLOAT32 = 0xca,
+            MP_FLOAT64 = 0xcb,
+            MP_UINT8 = 0xcc,
+            MP_UINT16 = 0xcd,
+            MP_UINT32 = 0xce,
+            MP_UINT64 = 0xcf,
+            MP_INT8 = 0xd0,
+            MP_INT16 = 0xd1,
+            MP_INT32 = 0xd2,
+            MP_INT64 = 0xd3,
+            MP_FIXEXT1 = 0xd4,
+            MP_FIXEXT16 = 0xd8,
+            MP_STR8 = 0xd9,
+            MP_STR16 = 0xda,
+            MP_STR32 = 0xdb,
+            MP_ARRAY16 = 0xdc,
+            MP_ARRAY32 = 0xdd,
+            MP_MAP16 = 0xde,
+            MP_MAP32 = 0xdf;
+
+        //values are stored big endian after the type byte
+        template <typename int_type>
+        void put_int(std::string &output, const uint8_t &type, const int_type &value)
+        {
+            auto bits = static_cast<std::make_unsigned_t<int_type>>(value);
+            output.push_back(static_cast<char>(type));
+            for (int shift = (sizeof(int_type) - 1) * 8; shift >= 0; shift -= 8)
+                output.push_back(static_cast<char>(bits >> shift));
+        }
+
+        void write_int(std::string &output, const int64_t &value)
+        {
+            if (value >= 0)
+            {
+                if (value <= 0x7f)
+                    output.push_back(static_cast<char>(value));
+
+                else if (value <= UINT8_MAX)
+                    put_int(output, MP_UINT8, static_cast<uint8_t>(value));
+
+                else if (value <= UINT16_MAX)
+                    put_int(output, MP_UINT16, static_cast<uint16_t>(value));
+
+                else if (value <= UINT32_MAX)
+                    put_int(output, MP_UINT32, static_cast<uint32_t>(value));
+
+                else
+                    put_int(output, MP_UINT64, static_cast<uint64_t>(value));
+            }
+            else if (value >= -32)
+                output.push_back(static_cast<char>(value));
+
+            else if (value >= INT8_MIN)
+                put_int(output, MP_INT8, static_cast<int8_t>(value));
+
+            else if (value >= INT16_MIN)
+                put_int(output, MP_INT16, static_cast<int16_t>(value));
+
+            else if (value >= INT32_MIN)
+                put_int(output, MP_INT32, static_cast<int32_t>(value));
+
+            else
+                put_int(output, MP_INT64, value);
+        }
+
+        void write_double(std::string &output, const double &value)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            put_int(output, MP_FLOAT64, bits);
+        }
+
+        void write_string(std::string &output, const std::string_view &value)
+        {
+            auto size = value.size();
+            if (size < 32)
+                output.push_back(static_cast<char>(0xa0 | size));
+
+            else if (size <= UINT8_MAX)
+                put_int(output, MP_STR8, static_cast<uint8_t>(size));
+
+            else if (size <= UINT16_MAX)
+                put_int(output, MP_STR16, static_cast<uint16_t>(size));
+
+            else
+                put_int(output, MP_STR32, static_cast<uint32_t>(size));
+
+            output.append(value.data(), size);
+        }
+
+        void write_bin(std::string &output, const blob_t &value)
+        {
+            auto size = value.size();
+            if (size <= UINT8_MAX)
+                put_int(output, MP_BIN8, static_cast<uint8_t>(size));
+
+            else if (size <= UINT16_MAX)
+                put_int(output, MP_BIN16, static_cast<uint16_t>(size));
+
+            else
+                put_int(output, MP_BIN32, static_cast<uint32_t>(size));
+
+            output.append(reinterpret_cast<const char *>(value.data()), size);
+        }
+
+        void write_array(std::string &output, const std::size_t &size)
+        {
+            if (size < 16)
+                output.push_back(static_cast<char>(0x90 | size));
+
+            else if (size <= UINT16_MAX)
+                put_int(output, MP_ARRAY16, static_cast<uint16_t>(size));
+
+            else
+                put_int(output, MP_ARRAY32, static_cast<uint32_t>(size));
+        }
+
+        void write_map(std::string &output, const std::size_t &size)
+        {
+            if (size < 16)
+                output.push_back(static_cast<char>(0x80 | size));
+
+            else if (size <= UINT16_MAX)
+                put_int(output, MP_MAP16, static_cast<uint16_t>(size));
+
+            else
+                put_int(output, MP_MAP32, static_cast<uint32_t>(size));
+        }
+
+        void write_id(std::string &output, const value_t &id)
+        {
+            std::visit([&](auto &&arg) {
+                using type = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<type, null_t>)
+                    output.push_back(static_cast<char>(MP_NIL));
+
+                else if constexpr (std::is_same_v<type, int32_t> || std::is_same_v<type, int64_t>)
+                    write_int(output, arg);
+
+                else if constexpr (std::is_same_v<type, std::string>)
+                    write_string(output, arg);
+
+                else
+                    throw ex_internal_error("Invalid id type.");
+            },
+                       id.get_variant());
+        }
+
+        void write_value(std::string &output, const value_t &value);
+
+        //writes the members of a reflected struct as they are visited
+        class field_writer_t : public field_visitor_t
+        {
+            std::string &m_output;
+
+        public:
+            field_writer_t(std::string &output) : m_output(output) {}
+
+            void field(const std::string_view &name, const value_t &value) override
+            {
+                write_string(m_output, name);
+                write_value(m_output, value);
+            }
+        };
+
+        void write_value(std::string &output, const value_t &value)
+        {
+            std::visit([&](auto &&arg) {
+                using type = std::decay_t<decltype(arg)>;
+                if constexpr (std::is_same_v<type, null_t>)
+                    output.push_back(static_cast<char>(MP_NIL));
+
+                else if constexpr (std::is_same_v<type, array_t>)
+                {
+                    write_array(output, arg.size());
+                    for (auto &e : arg)
+                        write_value(output, e);
+                }
+                else if constexpr (std::is_same_v<type, bool>)
+                    output.push_back(static_cast<char>(arg ? MP_TRUE : MP_FALSE));
+
+                else if constexpr (std::is_same_v<type, double>)
+                    write_double(output, arg);
+
+                else if constexpr (std::is_same_v<type, int32_t> || std::is_same_v<type, int64_t>)
+                    write_int(output, arg);
+
+                else if constexpr (std::is_same_v<type, std::string>)
+                    write_string(output, arg);
+
+                else if constexpr (std::is_same_v<type, blob_t>)
+                    write_bin(output, arg);
+
+                else if constexpr (std::is_same_v<type, double_array_t>)
+                {
+                    write_array(output, arg.size());
+                    output.reserve(output.size() + arg.size() * 9);
+                    for (auto &e : arg)
+                        write_double(output, e);
+                }
+                else if constexpr (std::is_same_v<type, int_array_t>)
+                {
+                    write_array(output, arg.size());
+                    for (auto &e : arg)
+                        write_int(output, e);
+                }
+
+                else if constexpr (std::is_same_v<type, struct_t>)
+                {
+                    write_map(output, arg.size());
+                    for (auto &e : arg)
+                    {
+                        write_string(output, e.first);
+                        write_value(output, e.second);
+                    }
+                }
+                else if constexpr (std::is_same_v<type, object_t>)
+                {
+                    write_map(output, arg.size());
+                    field_writer_t fields(output);
+                    arg.visit(fields);
+                }
+                //pre-encoded json has to be transcoded, methods that serve raw_json_t are meant for json clients
+                else if constexpr (std::is_same_v<type, raw_json_t>)
+                    write_value(output, reader::parse_value(arg.view()));
+
+                else
+                    throw ex_internal_error("Invalid object type.");
+            },
+                       value.get_variant());
+        }
+
+        //the map header, version member and result key every success response starts with, encoded once
+        const std::string &get_result_prefix()
+        {
+            static const std::string prefix = [] {
+                std::string prefix;
+                write_map(prefix, 3);
+                write_string(prefix, JSON_PROTO);
+                write_string(prefix, JSON_VER);
+                write_string(prefix, JSON_RESULT);
+                return prefix;
+            }();
+            return prefix;
+        }
+
+        void write_result(std::string &output, const value_t &value, const value_t &id)
+        {
+            if (!id.has_value())
+                throw ex_internal_error("Response was not notification with null id.");
+
+            output.append(get_result_prefix());
+            write_value(output, value);
+            write_string(output, JSON_ID);
+            write_id(output, id);
+        }
+
+        void write_raw_result(std::string &output, const std::string_view &fragment, const value_t &id)
+        {
+            if (!id.has_value())
+                throw ex_internal_error("Response was not notification with null id.");
+
+            output.append(get_result_prefix());
+            output.append(fragment.data(), fragment.size());
+            write_string(output, JSON_ID);
+            write_id(output, id);
+        }
+
+        void write_error(std::string &output, const response_t &error)
+        {
+            auto data = error.get_data();
+            write_map(output, 3);
+            write_string(output, JSON_PROTO);
+            write_string(output, JSON_VER);
+            write_string(output, JSON_ERROR);
+            write_map(output, data.has_value() ? 3 : 2);
+            write_string(output, JSON_CODE);
+            write_int(output, error.get_code());
+            write_string(output, JSON_MESSAGE);
+            write_string(output, error.get_message());
+            if (data.has_value())
+            {
+                write_string(output, JSON_DATA);
+                write_value(output, data);
+            }
+            write_string(output, JSON_ID);
+            write_id(output, error.get_id());
+        }
+
+        void write_response(std::string &output, const response_t &response)
+        {
+            if (response.has_error())
+                write_error(output, response);
+
+            else
+                write_result(output, response.get_value(), response.get_id());
+        }
+
+        void write_request(std::string &output, const request_t &request)
+        {
+            if (!request.is_notification() && !request.get_id().has_value())
+                throw ex_internal_error("Request was not notification with null id.");
+
+            write_map(output, 2 + request.has_params() + !request.is_notification());
+            write_string(output, JSON_PROTO);
+            write_string(output, JSON_VER);
+            write_string(output, JSON_METHOD);
+            write_string(output, request.get_method());
+            if (request.has_params())
+            {
+                write_string(output, JSON_PARAMS);
+                if (request.has_named_params())
+                    write_value(output, request.get_params_str());
+
+                else
+                    write_value(output, request.get_params_arr());
+            }
+
+            if (!request.is_notification())
+            {
+                write_string(output, JSON_ID);
+                write_id(output, request.get_id());
+            }
+        }
+
+        //reads one encoded value at a time from a buffer, malformed or truncated input throws a parse error
+        class decoder_t
+        {
+            //containers nested deeper than this are malformed, read_value and skip_value take a stack frame per level
+            static constexpr std::size_t MAX_DEPTH = 128;
+
+            const uint8_t *m_pos, *m_end;
+            const char *m_error;
+            std::size_t m_depth = 0;
+
+            //counts one level of nesting for as long as it lives
+            class nest_t
+            {
+                decoder_t &m_decoder;
+
+            public:
+                nest_t(decoder_t &decoder) : m_decoder(decoder)
+                {
+                    if (m_decoder.m_depth == MAX_DEPTH)
+                        throw ex_parse_error(m_decoder.m_error);
+
+                    m_decoder.m_depth++;
+                }
+
+                ~nest_t()
+                {
+                    m_decoder.m_depth--;
+                }
+            };
+
+            void require(const std::size_t &size) const
+            {
+                if (static_cast<std::size_t>(m_end - m_pos) < size)
+                    throw ex_parse_error(m_error);
+            }
+
+            template <typename int_type>
+            int_type get_int()
+            {
+                require(sizeof(int_type));
+                std::make_unsigned_t<int_type> bits = 0;
+                for (std::size_t i = 0; i < sizeof(int_type); i++)
+                    bits = static_cast<std::make_unsigned_t<int_type>>((bits << 8) | m_pos[i]);
+
+                m_pos += sizeof(int_type);
+                return static_cast<int_type>(bits);
+            }
+
+            const std::string_view get_bytes(const std::size_t &size)
+            {
+                require(size);
+                std::string_view bytes(reinterpret_cast<const char *>(m_pos), size);
+                m_pos += size;
+                return bytes;
+            }
+
+            const blob_t get_blob(const std::size_t &size)
+            {
+                auto bytes = get_bytes(size);
+                return blob_t(bytes.data(), bytes.size());
+            }
+
+            static const value_t get_int_obj(const int64_t &value)
+            {
+                if (value >= INT32_MIN && value <= INT32_MAX)
+                    return static_cast<int32_t>(value);
+
+                return value;
+            }
+
+            //element count of a container, each element takes at least one byte so larger counts are malformed
+            std::size_t get_count(const std::size_t &count)
+            {
+                require(count);
+                return count;
+            }
+
+        public:
+            decoder_t(const std::string_view &str, const char *error)
+                : m_pos(reinterpret_cast<const uint8_t *>(str.data())),
+                  m_end(reinterpret_cast<const uint8_t *>(str.data()) + str.size()), m_error(error) {}
+
+            const inline bool at_end() const
+            {
+                return m_pos == m_end;
+            }
+
+            const inline char *position() const
+            {
+                return reinterpret_cast<const char *>(m_pos);
+            }
+
+            //number of elements when the next value is an array, consumes the header
+            bool read_array(std::size_t &size)
+            {
+                require(1);
+                auto type = *m_pos;
+                if ((type & 0xf0) != 0x90 && type != MP_ARRAY16 && type != MP_ARRAY32)
+                    return false;
+
+                m_pos++;
+                size = get_count(type == MP_ARRAY16 ? get_int<uint16_t>() : type == MP_ARRAY32 ? get_int<uint32_t>() : type & 0x0f);
+                return true;
+            }
+
+            //number of members when the next value is a map, consumes the header
+            bool read_map(std::size_t &size)
+            {
+                require(1);
+                auto type = *m_pos;
+                if ((type & 0xf0) != 0x80 && type != MP_MAP16 && type != MP_MAP32)
+                    return false;
+
+                m_pos++;
+                size = get_count(type == MP_MAP16 ? get_int<uint16_t>() : type == MP_MAP32 ? get_int<uint32_t>() : type & 0x0f);
+                return true;
+            }
+
+            //the bytes of the next value when it is a string, they point into the message
+            bool read_string(std::string_view &str)
+            {
+                require(1);
+                auto type = *m_pos;
+                if ((type & 0xe0) == 0xa0)
+                {
+                    m_pos++;
+                    str = get_bytes(type & 0x1f);
+                    return true;
+                }
+
+                if (type != MP_STR8 && type != MP_STR16 && type != MP_STR32)
+                    return false;
+
+                m_pos++;
+                str = get_bytes(type == MP_STR8 ? get_int<uint8_t>() : type == MP_STR16 ? get_int<uint16_t>() : get_int<uint32_t>());
+                return true;
+            }
+
+            value_t read_value()
+            {
+                require(1);
+                auto type = *m_pos++;
+                if (type <= 0x7f)
+                    return static_cast<int32_t>(type);
+
+                if (type >= 0xe0)
+                    return static_cast<int32_t>(static_cast<int8_t>(type));
+
+                if ((type & 0xe0) == 0xa0)
+                    return std::string(get_bytes(type & 0x1f));
+
+                if ((type & 0xf0) == 0x90 || type == MP_ARRAY16 || type == MP_ARRAY32)
+                {
+                    auto size = get_count((type & 0xf0) == 0x90 ? type & 0x0f : type == MP_ARRAY16 ? get_int<uint16_t>() : get_int<uint32_t>());
+                    nest_t nest(*this);
+                    array_builder_t array;
+                    array.reserve(size);
+                    for (std::size_t i = 0; i < size; i++)
+                        array.push_value(read_value());
+
+                    return array.finish();
+                }
+
+                if ((type & 0xf0) == 0x80 || type == MP_MAP16 || type == MP_MAP32)
+                {
+                    auto size = get_count((type & 0xf0) == 0x80 ? type & 0x0f : type == MP_MAP16 ? get_int<uint16_t>() : get_int<uint32_t>());
+                    nest_t nest(*this);
+                    struct_t data;
+                    for (std::size_t i = 0; i < size; i++)
+                    {
+                        auto key = read_value();
+                        if (!key.is_type<std::string>())
+                            throw ex_bad_request("Invalid object type.");
+
+                        auto value = read_value();
+                        data.emplace(std::get<std::string>(key.get_variant()), std::move(value));
+                    }
+                    return data;
+                }
+
+                switch (type)
+                {
+                case MP_NIL:
+                    return null_t();
+
+                case MP_FALSE:
+                    return false;
+
+                case MP_TRUE:
+                    return true;
+
+                case MP_STR8:
+                    return std::string(get_bytes(get_int<uint8_t>()));
+
+                case MP_STR16:
+                    return std::string(get_bytes(get_int<uint16_t>()));
+
+                case MP_STR32:
+                    return std::string(get_bytes(get_int<uint32_t>()));
+
+                //the bytes are copied once into the blob's storage and shared from then on
+                case MP_BIN8:
+                    return get_blob(get_int<uint8_t>());
+
+                case MP_BIN16:
+                    return get_blob(get_int<uint16_t>());
+
+                case MP_BIN32:
+                    return get_blob(get_int<uint32_t>());
+
+                case MP_FLOAT32:
+                {
+                    auto bits = get_int<uint32_t>();
+                    float value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    return static_cast<double>(value);
+                }
+                case MP_FLOAT64:
+                {
+                    auto bits = get_int<uint64_t>();
+                    double value;
+                    std::memcpy(&value, &bits, sizeof(value));
+                    return value;
+                }
+                case MP_UINT8:
+                    return static_cast<int32_t>(get_int<uint8_t>());
+
+                case MP_UINT16:
+                    return static_cast<int32_t>(get_int<uint16_t>());
+
+                case MP_UINT32:
+                    return get_int_obj(get_int<uint32_t>());
+
+                case MP_UINT64:
+                {
+                    auto value = get_int<uint64_t>();
+                    if (value > static_cast<uint64_t>(INT64_MAX))
+                        return static_cast<double>(value);
+
+                    return get_int_obj(static_cast<int64_t>(value));
+                }
+                case MP_INT8:
+                    return static_cast<int32_t>(get_int<int8_t>());
+
+                case MP_INT16:
+                    return static_cast<int32_t>(get_int<int16_t>());
+
+                case MP_INT32:
+                    return get_int<int32_t>();
+
+                case MP_INT64:
+                    return get_int_obj(get_int<int64_t>());
+
+                case MP_EXT8:
+                case MP_EXT16:
+                case MP_EXT32:
+                    throw ex_bad_request("Invalid object type.");
+
+                default:
+                    if (type >= MP_FIXEXT1 && type <= MP_FIXEXT16)
+                        throw ex_bad_request("Invalid object type.");
+
+                    throw ex_parse_error(m_error);
+                }
+            }
+
+            //steps over the next value without decoding it
+            void skip_value()
+            {
+                require(1);
+                auto type = *m_pos++;
+                std::size_t count = 0, size = 0;
+                if (type <= 0x7f || type >= 0xe0 || type == MP_NIL || type == MP_FALSE || type == MP_TRUE)
+                    return;
+
+                else if ((type & 0xe0) == 0xa0)
+                    size = type & 0x1f;
+
+                else if ((type & 0xf0) == 0x90)
+                    count = type & 0x0f;
+
+                else if ((type & 0xf0) == 0x80)
+                    count = (type & 0x0f) * 2;
+
+                else
+                {
+                    switch (type)
+                    {
+                    case MP_BIN8:
+                    case MP_STR8:
+                        size = get_int<uint8_t>();
+                        break;
+
+                    case MP_BIN16:
+                    case MP_STR16:
+                        size = get_int<uint16_t>();
+                        break;
+
+                    case MP_BIN32:
+                    case MP_STR32:
+                        size = get_int<uint32_t>();
+                        break;
+
+                    case MP_EXT8:
+                        size = get_int<uint8_t>() + 1;
+                        break;
+
+                    case MP_EXT16:
+                        size = get_int<uint16_t>() + 1;
+                        break;
+
+                    case MP_EXT32:
+                        size = static_cast<std::size_t>(get_int<uint32_t>()) + 1;
+                        break;
+
+                    case MP_UINT8:
+                    case MP_INT8:
+                        size = 1;
+                        break;
+
+                    case MP_UINT16:
+                    case MP_INT16:
+                        size = 2;
+                        break;
+
+                    case MP_FLOAT32:
+                    case MP_UINT32:
+                    case MP_INT32:
+                        size = 4;
+                        break;
+
+                    case MP_FLOAT64:
+                    case MP_UINT64:
+                    case MP_INT64:
+                        size = 8;
+                        break;
+
+                    case MP_ARRAY16:
+                        count = get_int<uint16_t>();
+                        break;
+
+                    case MP_ARRAY32:
+                        count = get_int<uint32_t>();
+                        break;
+
+                    case MP_MAP16:
+                        count = get_int<uint16_t>() * std::size_t(2);
+                        break;
+
+                    case MP_MAP32:
+                        count = get_int<uint32_t>() * std::size_t(2);
+                        break;
+
+                    default:
+                        //fixext carries a type byte and 1 to 16 data bytes
+                        if (type >= MP_FIXEXT1 && type <= MP_FIXEXT16)
+                            size = (std::size_t(1) << (type - MP_FIXEXT1)) + 1;
+
+                        else
+                            throw ex_parse_error(m_error);
+                    }
+                }
+
+                get_bytes(size);
+                if (get_count(count) == 0)
+                    return;
+
+                nest_t nest(*this);
+                for (std::size_t i = count; i > 0; i--)
+                    skip_value();
+            }
+        };
+
+        //members of a map, a member whose value is not read is skipped when the next one is reached
+        class member_reader_t : public object_reader_t
+        {
+            decoder_t &m_decoder;
+            std::size_t m_remaining;
+            bool m_unread = false;
+
+        public:
+            member_reader_t(decoder_t &decoder, const std::size_t &size) : m_decoder(decoder), m_remaining(size) {}
+
+            bool next(std::string_view &key) override
+            {
+                skip();
+                if (m_remaining == 0)
+                    return false;
+
+                m_remaining--;
+                if (!m_decoder.read_string(key))
+                    throw ex_bad_request("Invalid object type.");
+
+                m_unread = true;
+                return true;
+            }
+
+            value_t value() override
+            {
+                m_unread = false;
+                return m_decoder.read_value();
+            }
+
+            bool object(const std::function<void(object_reader_t &)> &read) override
+            {
+                std::size_t size;
+                if (!m_decoder.read_map(size))
+                    return false;
+
+                m_unread = false;
+                member_reader_t members(m_decoder, size);
+                read(members);
+                members.finish();
+                return true;
+            }
+
+            void skip() override
+            {
+                if (m_unread)
+                    m_decoder.skip_value();
+
+                m_unread = false;
+            }
+
+            //steps over the members that were not read, leaving the decoder after the map
+            void finish()
+            {
+                std::string_view key;
+                while (next(key))
+                    ;
+            }
+        };
+
+        //decodes a whole message, trailing bytes are an error
+        const value_t parse(const std::string_view &str, const char *error)
+        {
+            decoder_t decoder(str, error);
+            auto value = decoder.read_value();
+            if (!decoder.at_end())
+                throw ex_parse_error(error);
+
+            return value;
+        }
+
+        const value_t get_id_obj(const value_t &id)
+        {
+            if (id.is_type<std::string>() || id.is_type<int32_t>() || id.is_type<int64_t>() || !id.has_value())
+                return id;
+
+            throw ex_bad_request("Invalid id type.");
+        }
+
+        //cheap check on the first byte, does not validate the message
+        const bool is_batch(const std::string_view &str)
+        {
+            if (str.empty())
+                return false;
+
+            auto type = static_cast<uint8_t>(str.front());
+            return (type & 0xf0) == 0x90 || type == MP_ARRAY16 || type == MP_ARRAY32;
+        }
+
+        const message_hint_t peek(const std::string_view &str)
+        {
+            message_hint_t hint;
+            constexpr std::string_view method_key("\xa6method", 7);
+            if (auto pos = str.find(method_key); pos != std::string_view::npos && pos + method_key.size() < str.size())
+            {
+                pos += method_key.size();
+                auto type = static_cast<uint8_t>(str[pos]);
+                if ((type & 0xe0) == 0xa0)
+                    hint.method = str.substr(pos + 1, type & 0x1f);
+
+                else if (type == MP_STR8 && pos + 1 < str.size())
+                    hint.method = str.substr(pos + 2, static_cast<uint8_t>(str[pos + 1]));
+            }
+
+            hint.notification = !is_batch(str) && str.find(std::string_view("\xa2id", 3)) == std::string_view::npos;
+            return hint;
+        }
+
+        //splits a batch into the encoded elements without decoding them
+        const std::vector<std::string> get_batch(const std::string_view &str)
+        {
+            std::vector<std::string> batch;
+            decoder_t decoder(str, "Batch parse error.");
+            std::size_t size;
+            if (!decoder.read_array(size))
+                return batch;
+
+            batch.reserve(size);
+            for (std::size_t i = 0; i < size; i++)
+            {
+                auto begin = decoder.position();
+                decoder.skip_value();
+                batch.emplace_back(begin, decoder.position() - begin);
+            }
+
+            if (!decoder.at_end())
+                throw ex_parse_error("Batch parse error.");
+
+            return batch;
+        }
+
+        //the members besides params are small and decoded as they come, params are decoded last so that with a
+        //lookup the positional params of reflected types are decoded straight from the message
+        const request_t deserialize_request(const std::string_view &request_string, const param_lookup_t *lookup = nullptr)
+        {
+            decoder_t decoder(request_string, "Request parse error.");
+            std::size_t size;
+            if (!decoder.read_map(size))
+            {
+                parse(request_string, "Request parse error.");
+                throw ex_bad_request("Request was not an object.");
+            }
+
+            struct_t object;
+            std::optional<std::string_view> params_bytes;
+            for (std::size_t i = 0; i < size; i++)
+            {
+                std::string_view key;
+                if (!decoder.read_string(key))
+                    throw ex_bad_request("Invalid object type.");
+
+                if (key != JSON_PARAMS)
+                    object.emplace(key, decoder.read_value());
+
+                else
+                {
+                    auto begin = decoder.position();
+                    decoder.skip_value();
+                    if (!params_bytes)
+                        params_bytes.emplace(begin, decoder.position() - begin);
+                }
+            }
+
+            if (!decoder.at_end())
+                throw ex_parse_error("Request parse error.");
+
+            auto member_end = object.end();
+            auto jrpc_version = object.find(JSON_PROTO);
+            auto method = object.find(JSON_METHOD);
+            auto id = object.find(JSON_ID);
+
+            if (jrpc_version == member_end || !jrpc_version->second.is_type<std::string>())
+                throw ex_bad_request("Invalid protocol.");
+
+            if (std::get<std::string>(jrpc_version->second.get_variant()) != JSON_VER)
+                throw ex_bad_request("Invalid protocol version.");
+
+            if (method == member_end || !method->second.is_type<std::string>())
+                throw ex_bad_request("Invalid method value.");
+
+            auto &method_name = std::get<std::string>(method->second.get_variant());
+            if (params_bytes)
+            {
+                decoder_t params_decoder(*params_bytes, "Request parse error.");
+                std::size_t count;
+                if (auto decoders = lookup ? lookup->find_decoders(method_name) : nullptr; decoders && params_decoder.read_array(count))
+                {
+                    array_t array;
+                    array.reserve(count);
+                    for (std::size_t i = 0; i < count; i++)
+                    {
+                        if (i >= decoders->size() || !(*decoders)[i])
+                        {
+                            array.push_back(params_decoder.read_value());
+                            continue;
+                        }
+
+                        //the param is stepped over first so a failed decode leaves the decoder at the next one
+                        auto begin = params_decoder.position();
+                        params_decoder.skip_value();
+                        decoder_t element(std::string_view(begin, params_decoder.position() - begin), "Request parse error.");
+                        std::size_t members;
+                        if (!element.read_map(members))
+                        {
+                            array.push_back(element.read_value());
+                            continue;
+                        }
+
+                        //a param that does not convert is left null and fails when the method is bound, as it
+                        //would have from a struct_t
+                        try
+                        {
+                            member_reader_t reader(element, members);
+                            array.push_back((*decoders)[i](reader));
+                        }
+                        catch (...)
+                        {
+                            array.emplace_back(null_t());
+                        }
+                    }
+
+                    if (id == member_end)
+                        return request_t(method_name, array);
+
+                    return request_t(method_name, array, get_id_obj(id->second));
+                }
+
+                auto params = params_decoder.read_value();
+                if (params.is_array())
+                {
+                    auto array = params.get_value<array_t>();
+                    if (id == member_end)
+                        return request_t(method_name, array);
+
+                    return request_t(method_name, array, get_id_obj(id->second));
+                }
+                else if (params.is_type<struct_t>())
+                {
+                    auto &data = std::get<struct_t>(params.get_variant());
+                    if (id == member_end)
+                        return request_t(method_name, data);
+
+                    return request_t(method_name, data, get_id_obj(id->second));
+                }
+                else
+                {
+                    throw ex_bad_request();
+                }
+            }
+
+            if (id == member_end)
+                return request_t(method_name);
+
+            return request_t(method_name, get_id_obj(id->second));
+        }
+
+        const response_t deserialize_response(const std::string_view &response_string)
+        {
+            auto document = parse(response_string, "Response parse error.");
+            if (!document.is_type<struct_t>())
+                throw ex_bad_request("Response was not an object.");
+
+            auto &object = std::get<struct_t>(document.get_variant());
+            auto member_end = object.end();
+            auto jrpc_version = object.find(JSON_PROTO);
+            auto id = object.find(JSON_ID);
+            auto result = object.find(JSON_RESULT);
+            auto error = object.find(JSON_ERROR);
+
+            if (jrpc_version == member_end || !jrpc_version->second.is_type<std::string>())
+                throw ex_bad_request("Invalid protocol.");
+
+            if (std::get<std::string>(jrpc_version->second.get_variant()) != JSON_VER)
+                throw ex_bad_request("Invalid protocol version.");
+
+            if (id == member_end)
+                throw ex_bad_request("Missing response id.");
+
+            if (result != member_end)
+            {
+                if (error != member_end)
+                    throw ex_bad_request("Non-exclusive result.");
+
+                return response_t(result->second, get_id_obj(id->second));
+            }
+            else if (error != member_end)
+            {
+                if (!error->second.is_type<struct_t>())
+                    throw ex_bad_request("Error was not an object.");
+
+                auto &error_object = std::get<struct_t>(error->second.get_variant());
+                auto error_end = error_object.end();
+                auto code = error_object.find(JSON_CODE);
+                if (code == error_end || !code->second.is_type<int32_t>())
+                    throw ex_bad_request("Invalid error code value.");
+
+                auto message = error_object.find(JSON_MESSAGE);
+                if (message == error_end || !message->second.is_type<std::string>())
+                    throw ex_bad_request("Invalid error message value.");
+
+                auto error_code = std::get<int32_t>(code->second.get_variant());
+                auto &error_message = std::get<std::string>(message->second.get_variant());
+                auto data = error_object.find(JSON_DATA);
+                if (data != error_end)
+                    return response_t(error_code, error_message, get_id_obj(id->second), data->second);
+
+                return response_t(error_code, error_message, get_id_obj(id->second));
+            }
+            else
+                throw ex_bad_request("Non-inclusive result.");
+        }
+
+        //assembles a batch response from element responses that are already serialized. the array header carries
+        //the element count, so the elements are collected and the header is put in front of them at the end
+        class batch_writer_t
+        {
+            std::size_t m_count = 0;
+
+        public:
+            static constexpr bool streams = false;
+
+            void next(std::string &)
+            {
+                m_count++;
+            }
+
+            void finish(std::string &output)
+            {
+                std::string header;
+                write_array(header, m_count);
+                output.insert(0, header);
+            }
+        };
+
+        const std::string
+        serialize_value(const value_t &value)
+        {
+            std::string output;
+            write_value(output, value);
+            return output;
+        }
+
+        const std::string
+        serialize_batch_request(const std::vector<request_t> &requests)
+        {
+            std::string output;
+            write_array(output, requests.size());
+            for (auto &e : requests)
+                write_request(output, e);
+
+            return output;
+        }
+
+        const std::string
+        serialize_batch_response(const std::vector<response_t> &responses)
+        {
+            std::string output;
+            write_array(output, std::count_if(responses.begin(), responses.end(), [](const response_t &e) {
+                            return !e.is_notification() || e.has_error();
+                        }));
+            for (auto &e : responses)
+            {
+                if (e.is_notification() && !e.has_error())
+                    continue;
+
+                write_response(output, e);
+            }
+            return output;
+        }
+
+        const std::string
+        serialize_request(const request_t &request)
+        {
+            std::string output;
+            write_request(output, request);
+            return output;
+        }
+
+        const std::string
+        serialize_response(const response_t &response)
+        {
+            if (response.is_notification() && !response.has_error())
+                return "";
+
+            std::string output;
+            write_response(output, response);
+            return output;
+        }
+    }; // namespace msgpack
+} // namespace rpc_light
\ No newline at end of file
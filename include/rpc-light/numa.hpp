@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace rpc_light
+{
+    struct numa_node_t
+    {
+        int id;
+        std::vector<int> cpus;
+    };
+
+    namespace numa
+    {
+        //parses a kernel cpu list like "0-3,8-11"
+        std::vector<int> parse_cpu_list(const std::string &list)
+        {
+            std::vector<int> cpus;
+            std::stringstream stream(list);
+            std::string range;
+            while (std::getline(stream, range, ','))
+            {
+                if (range.empty() || range == "\n")
+                    continue;
+
+                auto dash = range.find('-');
+                auto first = std::stoi(range.substr(0, dash));
+                auto last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+                for (auto cpu = first; cpu <= last; cpu++)
+                    cpus.push_back(cpu);
+            }
+            return cpus;
+        }
+
+        const std::vector<numa_node_t> read_nodes()
+        {
+            std::vector<numa_node_t> nodes;
+#ifdef __linux__
+            std::ifstream online("/sys/devices/system/node/online");
+            std::string list;
+            if (online && std::getline(online, list))
+                for (auto id : parse_cpu_list(list))
+                {
+                    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+                    std::string cpus;
+                    if (cpulist && std::getline(cpulist, cpus))
+                        if (auto parsed = parse_cpu_list(cpus); !parsed.empty())
+                            nodes.push_back({id, std::move(parsed)});
+                }
+#endif
+            //without a topology every cpu is on one node
+            if (nodes.empty())
+            {
+                numa_node_t node{0, {}};
+                for (unsigned int i = 0; i < std::max(1u, std::thread::hardware_concurrency()); i++)
+                    node.cpus.push_back(i);
+
+                nodes.push_back(std::move(node));
+            }
+            return nodes;
+        }
+
+        //the nodes with at least one cpu, read once
+        const std::vector<numa_node_t> &nodes()
+        {
+            static const std::vector<numa_node_t> nodes = read_nodes();
+            return nodes;
+        }
+
+        const int node_of_cpu(const int &cpu)
+        {
+            for (auto &e : nodes())
+                if (std::find(e.cpus.begin(), e.cpus.end(), cpu) != e.cpus.end())
+                    return e.id;
+
+            return -1;
+        }
+
+        //the node of the cpu the calling thread is running on, -1 when unknown
+        const int current_node()
+        {
+#ifdef __linux__
+            if (auto cpu = sched_getcpu(); cpu >= 0)
+                return node_of_cpu(cpu);
+#endif
+            return -1;
+        }
+
+        //one cpu per worker for an executor_config_t::cpu_affinity, workers are dealt round robin across the
+        //nodes and fill each node's cpus in order, so neighbouring workers never share a node unless they must
+        const std::vector<int> spread_affinity(const unsigned int &threads)
+        {
+            auto &all = nodes();
+            std::vector<int> cpus;
+            cpus.reserve(threads);
+            for (unsigned int i = 0; i < threads; i++)
+            {
+                auto &node = all[i % all.size()];
+                cpus.push_back(node.cpus[(i / all.size()) % node.cpus.size()]);
+            }
+            return cpus;
+        }
+
+        //one cpu per worker, all on the given node
+        const std::vector<int> node_affinity(const int &id, const unsigned int &threads)
+        {
+            std::vector<int> cpus;
+            for (auto &e : nodes())
+                if (e.id == id)
+                    for (unsigned int i = 0; i < threads; i++)
+                        cpus.push_back(e.cpus[i % e.cpus.size()]);
+
+            return cpus;
+        }
+    } // namespace numa
+} // namespace rpc_light
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <utility>
+
+namespace rpc_light
+{
+    //bounded lock-free multi-producer multi-consumer ring, each cell carries a sequence number
+    //that tells producers and consumers whether the slot is free for their lap of the ring
+    template <typename value_type>
+    class mpmc_queue_t
+    {
+        struct cell_t
+        {
+            std::atomic<std::size_t> sequence;
+            value_type value;
+        };
+
+        std::unique_ptr<cell_t[]> m_cells;
+        std::size_t m_mask;
+        alignas(64) std::atomic<std::size_t> m_enqueue_pos{0};
+        alignas(64) std::atomic<std::size_t> m_dequeue_pos{0};
+
+    public:
+        explicit mpmc_queue_t(const std::size_t &capacity)
+        {
+            std::size_t size = 2;
+            while (size < capacity)
+                size <<= 1;
+
+            m_cells.reset(new cell_t[size]);
+            m_mask = size - 1;
+            for (std::size_t i = 0; i < size; i++)
+                m_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+
+        mpmc_queue_t(const mpmc_queue_t &) = delete;
+        mpmc_queue_t &operator=(const mpmc_queue_t &) = delete;
+
+        //the value is only consumed when the push succeeds
+        template <typename push_type>
+        bool try_push(push_type &&value)
+        {
+            auto pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            cell_t *cell;
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                auto sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+
+                else
+                    pos = m_enqueue_pos.load(std::memory_order_relaxed);
+            }
+            cell->value = std::forward<push_type>(value);
+            cell->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool try_pop(value_type &value)
+        {
+            auto pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            cell_t *cell;
+            while (true)
+            {
+                cell = &m_cells[pos & m_mask];
+                auto sequence = cell->sequence.load(std::memory_order_acquire);
+                auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+                if (diff == 0)
+                {
+                    if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+
+                else
+                    pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+            value = std::move(cell->value);
+            cell->value = value_type();
+            cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+            return true;
+        }
+
+        const inline std::size_t capacity() const
+        {
+            return m_mask + 1;
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
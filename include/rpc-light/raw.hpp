@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <memory>
+
+namespace rpc_light
+{
+    //json text that is already encoded, json responses copy it verbatim and copies of it share the text.
+    //it has to hold exactly one valid json value, it is not checked. binary codecs parse it when writing
+    class raw_json_t
+    {
+        std::shared_ptr<const std::string> m_text;
+
+    public:
+        raw_json_t() : raw_json_t("null") {}
+
+        explicit raw_json_t(std::string text) : m_text(std::make_shared<const std::string>(std::move(text))) {}
+
+        const inline std::string_view view() const
+        {
+            return *m_text;
+        }
+
+        const inline std::size_t size() const
+        {
+            return m_text->size();
+        }
+
+        const bool operator==(const raw_json_t &other) const
+        {
+            return m_text == other.m_text || *m_text == *other.m_text;
+        }
+
+        const bool operator!=(const raw_json_t &other) const
+        {
+            return !(*this == other);
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "config.hpp"
 #include "exceptions.hpp"
 #include "aliases.hpp"
 #include "value.hpp"
@@ -9,17 +10,136 @@
 #include "../rapidjson/writer.h"
 #include "../rapidjson/stringbuffer.h"
 
+#ifdef RPC_LIGHT_SIMDJSON
+#include "simdjson_reader.hpp"
+#endif
+
 #include <string>
 #include <vector>
+#include <optional>
+#include <memory>
+#include <algorithm>
 
 namespace rpc_light
 {
     namespace reader
     {
+        //the parse stack lives in a pool as well so it is not freed after every parse
+        using document_t = rapidjson::GenericDocument<rapidjson::UTF8<>, rapidjson::MemoryPoolAllocator<>,
+                                                      rapidjson::MemoryPoolAllocator<>>;
+
+        //per-thread parse scratch memory, each pool keeps a buffer sized to the largest message seen
+        //and is cleared rather than destroyed, so steady-state parsing does not touch the system allocator
+        class context_t
+        {
+            static constexpr std::size_t value_buffer_size = 16 * 1024, stack_buffer_size = 4 * 1024,
+                                         max_buffer_size = 4 * 1024 * 1024;
+
+            std::vector<char> m_value_buffer, m_stack_buffer;
+            std::optional<rapidjson::MemoryPoolAllocator<>> m_value_alloc, m_stack_alloc;
+            rapidjson::StringBuffer m_strbuf;
+            rapidjson::Writer<rapidjson::StringBuffer> m_writer;
+
+            static void reset(std::vector<char> &buffer, std::optional<rapidjson::MemoryPoolAllocator<>> &alloc)
+            {
+                if (alloc && (alloc->Capacity() <= buffer.size() || buffer.size() >= max_buffer_size))
+                    return alloc->Clear();
+
+                //the pool outgrew its buffer, replace it with one that covers the new high-water mark
+                auto size = alloc ? std::min(alloc->Capacity() * 2, max_buffer_size) : buffer.size();
+                alloc.reset();
+                buffer.resize(size);
+                alloc.emplace(buffer.data(), buffer.size(), buffer.size());
+            }
+
+        public:
+            context_t()
+                : m_value_buffer(value_buffer_size), m_stack_buffer(stack_buffer_size), m_writer(m_strbuf)
+            {
+                clear();
+            }
+
+            context_t(const context_t &) = delete;
+            context_t &operator=(const context_t &) = delete;
+
+            document_t document()
+            {
+                return document_t(&*m_value_alloc, m_stack_buffer.size() / 2, &*m_stack_alloc);
+            }
+
+            //writer over the reusable buffer, cleared on every call
+            rapidjson::Writer<rapidjson::StringBuffer> &writer()
+            {
+                m_strbuf.Clear();
+                m_writer.Reset(m_strbuf);
+                return m_writer;
+            }
+
+            const rapidjson::StringBuffer &buffer() const
+            {
+                return m_strbuf;
+            }
+
+            //documents built from this context must be gone before it is cleared
+            void clear()
+            {
+                reset(m_value_buffer, m_value_alloc);
+                reset(m_stack_buffer, m_stack_alloc);
+            }
+        };
+
+        //borrows the calling thread's context for one parse, nested parses on the same thread get a private one
+        class context_lease_t
+        {
+            static inline thread_local context_t t_context;
+            static inline thread_local bool t_leased = false;
+
+            std::unique_ptr<context_t> m_owned;
+            context_t *m_context;
+
+        public:
+            context_lease_t()
+            {
+                if (t_leased)
+                {
+                    m_owned = std::make_unique<context_t>();
+                    m_context = m_owned.get();
+                }
+                else
+                {
+                    t_leased = true;
+                    m_context = &t_context;
+                }
+            }
+
+            context_lease_t(const context_lease_t &) = delete;
+            context_lease_t &operator=(const context_lease_t &) = delete;
+
+            ~context_lease_t()
+            {
+                if (m_owned)
+                    return;
+
+                m_context->clear();
+                t_leased = false;
+            }
+
+            context_t *operator->() const
+            {
+                return m_context;
+            }
+        };
+
+        //rapidjson strings may hold embedded nulls, always go by the stored length
+        const std::string_view get_string(const rapidjson::Value &value)
+        {
+            return std::string_view(value.GetString(), value.GetStringLength());
+        }
+
         const value_t get_id_obj(const rapidjson::Value &id)
         {
             if (id.IsString())
-                return std::string(id.GetString());
+                return std::string(get_string(id));
 
             else if (id.IsInt())
                 return id.GetInt();
@@ -33,7 +153,7 @@ namespace rpc_light
             throw ex_bad_request("Invalid id type.");
         }
 
-        const value_t get_value_obj(const rapidjson::Value &value)
+        value_t get_value_obj(const rapidjson::Value &value)
         {
             switch (value.GetType())
             {
@@ -50,21 +170,29 @@ namespace rpc_light
             {
                 struct_t data;
                 for (auto &e : value.GetObject())
-                    data.emplace(std::string_view(e.name.GetString()), get_value_obj(e.value));
+                    data.emplace(get_string(e.name), get_value_obj(e.value));
 
                 return data;
             }
             case rapidjson::kArrayType:
             {
-                array_t array;
+                array_builder_t array;
                 array.reserve(value.Size());
                 for (auto &e : value.GetArray())
-                    array.emplace_back(get_value_obj(e));
+                {
+                    if (e.IsInt64())
+                        array.push_int(e.GetInt64());
+
+                    else if (e.IsNumber())
+                        array.push_double(e.GetDouble());
 
-                return array;
+                    else
+                        array.push_value(get_value_obj(e));
+                }
+                return array.finish();
             }
             case rapidjson::kStringType:
-                return std::string(value.GetString());
+                return std::string(get_string(value));
 
             case rapidjson::kNumberType:
             {
@@ -87,11 +215,107 @@ namespace rpc_light
             throw ex_bad_request("Invalid object type.");
         }
 
+        //members of a parsed object, read in document order
+        class member_reader_t : public object_reader_t
+        {
+            rapidjson::Value::ConstMemberIterator m_iter, m_end;
+            bool m_started = false;
+
+        public:
+            member_reader_t(const rapidjson::Value &object) : m_iter(object.MemberBegin()), m_end(object.MemberEnd()) {}
+
+            bool next(std::string_view &key) override
+            {
+                if (m_started)
+                    ++m_iter;
+
+                m_started = true;
+                if (m_iter == m_end)
+                    return false;
+
+                key = get_string(m_iter->name);
+                return true;
+            }
+
+            value_t value() override
+            {
+                return get_value_obj(m_iter->value);
+            }
+
+            bool object(const std::function<void(object_reader_t &)> &read) override
+            {
+                if (!m_iter->value.IsObject())
+                    return false;
+
+                member_reader_t members(m_iter->value);
+                read(members);
+                return true;
+            }
+
+            void skip() override {}
+        };
+
+        //positional params, objects at a position with a decoder are decoded by it. a param that does not
+        //convert is left null and fails when the method is bound, as it would have from a struct_t
+        array_t get_params_arr(const rapidjson::Value &params, const param_decoders_t &decoders)
+        {
+            array_t array;
+            array.reserve(params.Size());
+            for (rapidjson::SizeType i = 0; i < params.Size(); i++)
+            {
+                if (i < decoders.size() && decoders[i] && params[i].IsObject())
+                {
+                    try
+                    {
+                        member_reader_t members(params[i]);
+                        array.push_back(decoders[i](members));
+                    }
+                    catch (...)
+                    {
+                        array.emplace_back(null_t());
+                    }
+                }
+                else
+                    array.push_back(get_value_obj(params[i]));
+            }
+            return array;
+        }
+
+        //cheap check on the first significant character, does not validate the document
+        const bool is_batch(const std::string_view &str)
+        {
+            for (auto &e : str)
+            {
+                if (e == ' ' || e == '\t' || e == '\n' || e == '\r')
+                    continue;
+
+                return e == '[';
+            }
+            return false;
+        }
+
+        const message_hint_t peek(const std::string_view &str)
+        {
+            message_hint_t hint;
+            constexpr std::string_view method_key("\"method\"");
+            if (auto pos = str.find(method_key); pos != std::string_view::npos)
+                if (auto open = str.find('"', pos + method_key.size()); open != std::string_view::npos)
+                    if (auto close = str.find('"', open + 1); close != std::string_view::npos)
+                        hint.method = str.substr(open + 1, close - open - 1);
+
+            hint.notification = !is_batch(str) && str.find("\"id\"") == std::string_view::npos;
+            return hint;
+        }
+
         const std::vector<std::string> get_batch(const std::string_view &str)
         {
+#ifdef RPC_LIGHT_SIMDJSON
+            return simdjson_reader::get_batch(str);
+#else
             std::vector<std::string> batch;
-            rapidjson::Document document;
-            document.Parse(str.data());
+            context_lease_t context;
+            auto document = context->document();
+            document.Parse(str.data(), str.size());
             if (document.HasParseError())
                 throw ex_parse_error("Batch parse error.");
 
@@ -101,19 +325,39 @@ namespace rpc_light
                 batch.reserve(arr.Size());
                 for (auto &e : arr)
                 {
-                    rapidjson::StringBuffer strbuf;
-                    rapidjson::Writer writer(strbuf);
-                    e.Accept(writer);
-                    batch.push_back(strbuf.GetString());
+                    e.Accept(context->writer());
+                    batch.emplace_back(context->buffer().GetString(), context->buffer().GetSize());
                 }
             }
             return batch;
+#endif
         }
 
-        const request_t deserialize_request(const std::string_view &request_string)
+        //parses a standalone json value, such as the text of a raw_json_t
+        const value_t parse_value(const std::string_view &str)
         {
-            rapidjson::Document document;
-            document.Parse(request_string.data());
+#ifdef RPC_LIGHT_SIMDJSON
+            return simdjson_reader::parse_value(str);
+#else
+            context_lease_t context;
+            auto document = context->document();
+            document.Parse(str.data(), str.size());
+            if (document.HasParseError())
+                throw ex_parse_error("Value parse error.");
+
+            return get_value_obj(document);
+#endif
+        }
+
+        //with a lookup, positional params of reflected types are decoded straight from the document
+        const request_t deserialize_request(const std::string_view &request_string, const param_lookup_t *lookup = nullptr)
+        {
+#ifdef RPC_LIGHT_SIMDJSON
+            return simdjson_reader::deserialize_request(request_string, lookup);
+#else
+            context_lease_t context;
+            auto document = context->document();
+            document.Parse(request_string.data(), request_string.size());
             if (document.HasParseError())
                 throw ex_parse_error("Request parse error.");
             if (!document.IsObject())
@@ -128,7 +372,7 @@ namespace rpc_light
             if (jrpc_version == member_end || !jrpc_version->value.IsString())
                 throw ex_bad_request("Invalid protocol.");
 
-            if (std::string_view(jrpc_version->value.GetString()) != JSON_VER)
+            if (get_string(jrpc_version->value) != JSON_VER)
                 throw ex_bad_request("Invalid protocol version.");
 
             if (method == member_end || !method->value.IsString())
@@ -138,17 +382,26 @@ namespace rpc_light
             {
                 if (json_params->value.IsArray())
                 {
+                    if (auto decoders = lookup ? lookup->find_decoders(std::string(get_string(method->value))) : nullptr)
+                    {
+                        auto params = get_params_arr(json_params->value, *decoders);
+                        if (id == member_end)
+                            return request_t(get_string(method->value), params);
+
+                        return request_t(get_string(method->value), params, get_id_obj(id->value));
+                    }
+
                     if (id == member_end)
-                        return request_t(method->value.GetString(), get_value_obj(json_params->value).get_value<array_t>());
+                        return request_t(get_string(method->value), get_value_obj(json_params->value).get_value<array_t>());
 
-                    return request_t(method->value.GetString(), get_value_obj(json_params->value).get_value<array_t>(), get_id_obj(id->value));
+                    return request_t(get_string(method->value), get_value_obj(json_params->value).get_value<array_t>(), get_id_obj(id->value));
                 }
                 else if (json_params->value.IsObject())
                 {
                     if (id == member_end)
-                        return request_t(method->value.GetString(), get_value_obj(json_params->value).get_value<struct_t>());
+                        return request_t(get_string(method->value), get_value_obj(json_params->value).get_value<struct_t>());
 
-                    return request_t(method->value.GetString(), get_value_obj(json_params->value).get_value<struct_t>(), get_id_obj(id->value));
+                    return request_t(get_string(method->value), get_value_obj(json_params->value).get_value<struct_t>(), get_id_obj(id->value));
                 }
                 else
                 {
@@ -157,15 +410,20 @@ namespace rpc_light
             }
 
             if (id == member_end)
-                return request_t(method->value.GetString());
+                return request_t(get_string(method->value));
 
-            return request_t(method->value.GetString(), get_id_obj(id->value));
+            return request_t(get_string(method->value), get_id_obj(id->value));
+#endif
         }
 
         const response_t deserialize_response(const std::string_view &response_string)
         {
-            rapidjson::Document document;
-            document.Parse(response_string.data());
+#ifdef RPC_LIGHT_SIMDJSON
+            return simdjson_reader::deserialize_response(response_string);
+#else
+            context_lease_t context;
+            auto document = context->document();
+            document.Parse(response_string.data(), response_string.size());
             if (document.HasParseError())
                 throw ex_parse_error("Response parse error.");
 
@@ -181,7 +439,7 @@ namespace rpc_light
             if (jrpc_version == member_end || !jrpc_version->value.IsString())
                 throw ex_bad_request("Invalid protocol.");
 
-            if (std::string_view(jrpc_version->value.GetString()) != JSON_VER)
+            if (get_string(jrpc_version->value) != JSON_VER)
                 throw ex_bad_request("Invalid protocol version.");
 
             if (id == member_end)
@@ -212,14 +470,15 @@ namespace rpc_light
 
                 auto data = error->value.FindMember(JSON_DATA);
                 if (data != member_end)
-                    return response_t(code->value.GetInt(), message->value.GetString(),
+                    return response_t(code->value.GetInt(), get_string(message->value),
                                       get_id_obj(id->value), get_value_obj(data->value));
 
-                return response_t(code->value.GetInt(), message->value.GetString(),
+                return response_t(code->value.GetInt(), get_string(message->value),
                                   get_id_obj(id->value));
             }
             else
                 throw ex_bad_request("Non-inclusive result.");
+#endif
         }
     }; // namespace reader
 } // namespace rpc_light
\ No newline at end of file
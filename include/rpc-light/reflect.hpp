@@ -0,0 +1,173 @@
+#pragma once
+
+#include "exceptions.hpp"
+
+#include <string_view>
+#include <tuple>
+#include <memory>
+#include <typeinfo>
+#include <type_traits>
+#include <functional>
+
+//describes the members of a user struct so it can be used as a param or return type directly,
+//place it at namespace scope after the struct. members are matched by name and listed in this order
+//  RPC_LIGHT_REFLECT(point_t, x, y)
+#define RPC_LIGHT_REFLECT(type, ...)                                                            \
+    template <>                                                                                \
+    struct rpc_light::reflect_t<type>                                                          \
+    {                                                                                          \
+        using reflected_type = type;                                                           \
+        static constexpr auto fields = std::make_tuple(RPC_LIGHT_FOR_EACH(RPC_LIGHT_FIELD, __VA_ARGS__)); \
+    };
+
+#define RPC_LIGHT_FIELD(member) rpc_light::field(#member, &reflected_type::member)
+
+//expands macro(x) for up to 32 comma separated arguments
+#define RPC_LIGHT_EXPAND(...) __VA_ARGS__
+#define RPC_LIGHT_COUNT(...) RPC_LIGHT_EXPAND(RPC_LIGHT_COUNT_N(__VA_ARGS__, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, \
+                                                             16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+#define RPC_LIGHT_COUNT_N(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, _17, _18, _19, _20, \
+                          _21, _22, _23, _24, _25, _26, _27, _28, _29, _30, _31, _32, n, ...) n
+#define RPC_LIGHT_CONCAT(a, b) RPC_LIGHT_CONCAT_I(a, b)
+#define RPC_LIGHT_CONCAT_I(a, b) a##b
+#define RPC_LIGHT_FOR_EACH(macro, ...) RPC_LIGHT_EXPAND(RPC_LIGHT_CONCAT(RPC_LIGHT_FE_, RPC_LIGHT_COUNT(__VA_ARGS__))(macro, __VA_ARGS__))
+#define RPC_LIGHT_FE_1(m, x) m(x)
+#define RPC_LIGHT_FE_2(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_1(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_3(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_2(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_4(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_3(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_5(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_4(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_6(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_5(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_7(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_6(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_8(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_7(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_9(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_8(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_10(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_9(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_11(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_10(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_12(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_11(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_13(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_12(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_14(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_13(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_15(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_14(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_16(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_15(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_17(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_16(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_18(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_17(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_19(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_18(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_20(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_19(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_21(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_20(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_22(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_21(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_23(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_22(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_24(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_23(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_25(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_24(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_26(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_25(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_27(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_26(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_28(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_27(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_29(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_28(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_30(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_29(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_31(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_30(m, __VA_ARGS__))
+#define RPC_LIGHT_FE_32(m, x, ...) m(x), RPC_LIGHT_EXPAND(RPC_LIGHT_FE_31(m, __VA_ARGS__))
+
+namespace rpc_light
+{
+    class value_t;
+
+    //specialized through RPC_LIGHT_REFLECT, or by hand with a constexpr tuple of field() entries named fields
+    template <typename type>
+    struct reflect_t;
+
+    template <typename type, typename = void>
+    struct is_reflected : std::false_type
+    {
+    };
+    template <typename type>
+    struct is_reflected<type, std::void_t<decltype(reflect_t<type>::fields)>> : std::true_type
+    {
+    };
+    template <typename type>
+    inline constexpr bool is_reflected_v = is_reflected<type>::value;
+
+    template <typename class_type, typename member_type>
+    struct field_t
+    {
+        using type = member_type;
+        const char *name;
+        member_type class_type::*member;
+    };
+
+    template <typename class_type, typename member_type>
+    constexpr field_t<class_type, member_type> field(const char *name, member_type class_type::*member)
+    {
+        return {name, member};
+    }
+
+    //receives the members of a reflected object in declaration order, writers implement it to encode
+    //the members straight from the user struct
+    class field_visitor_t
+    {
+    public:
+        virtual void field(const std::string_view &name, const value_t &value) = 0;
+
+    protected:
+        ~field_visitor_t() = default;
+    };
+
+    //walks the members of an encoded object in the order they appear, readers implement it over their parser
+    //so a reflected struct is decoded straight from the message without building a struct_t
+    class object_reader_t
+    {
+    public:
+        //moves to the next member, false after the last one. the key is valid until the next call
+        virtual bool next(std::string_view &key) = 0;
+        //decodes the value of the current member
+        virtual value_t value() = 0;
+        //calls read with a reader over the current member's value, false without calling it when the value
+        //is not an object
+        virtual bool object(const std::function<void(object_reader_t &)> &read) = 0;
+        //steps over the current member's value without decoding it
+        virtual void skip() = 0;
+
+    protected:
+        ~object_reader_t() = default;
+    };
+
+    //a reflected user struct held by value_t, copies share one instance of it.
+    //no map of members is built, the field list is walked when the object is written or read back
+    class object_t
+    {
+        std::shared_ptr<const void> m_object;
+        const std::type_info *m_type = nullptr;
+        void (*m_visit)(const void *, field_visitor_t &) = nullptr;
+        std::size_t m_size = 0;
+
+    public:
+        object_t() {}
+
+        //defined in value.hpp, the member values are boxed into value_t while visiting
+        template <typename type, typename = std::enable_if_t<is_reflected_v<type>>>
+        object_t(const type &object);
+
+        template <typename type>
+        const inline bool is_type() const
+        {
+            return m_type && *m_type == typeid(type);
+        }
+
+        template <typename type>
+        const inline type &get() const
+        {
+            if (!is_type<type>())
+                throw ex_internal_error("Bad object type.");
+
+            return *static_cast<const type *>(m_object.get());
+        }
+
+        //number of members, encoders that write a length header need it up front
+        const inline std::size_t size() const
+        {
+            return m_size;
+        }
+
+        void visit(field_visitor_t &visitor) const
+        {
+            if (m_visit)
+                m_visit(m_object.get(), visitor);
+        }
+    };
+} // namespace rpc_light
\ No newline at end of file
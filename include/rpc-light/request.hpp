@@ -5,9 +5,43 @@
 #include "value.hpp"
 
 #include <string>
+#include <vector>
 
 namespace rpc_light
 {
+    //what a byte scan of an undecoded message suggests about it, used for scheduling decisions that are made
+    //before the message is parsed. it can be wrong for unusual messages, nothing depends on it for correctness
+    struct message_hint_t
+    {
+        //the first method named in the message, empty when none was found
+        std::string_view method;
+        //no id member was found in a message that is not a batch
+        bool notification = false;
+    };
+
+    //decodes one positional param straight from the message, see read_object
+    using param_decoder_t = value_t (*)(object_reader_t &);
+    //one entry per positional param of a method, null for params that are decoded into value_t as usual
+    using param_decoders_t = std::vector<param_decoder_t>;
+
+    //supplies the decoders of a method's params to a reader while the method's request is parsed, so params of
+    //reflected types are decoded into an object_t without building a struct_t first. see dispatcher_t
+    class param_lookup_t
+    {
+    public:
+        //the decoders of the method, null when it has none. they must outlive the lookup
+        virtual const param_decoders_t *find_decoders(const std::string &method) const = 0;
+
+    protected:
+        ~param_lookup_t() = default;
+    };
+
+    template <typename type>
+    value_t decode_param(object_reader_t &reader)
+    {
+        return value_t(read_object<type>(reader));
+    }
+
     class request_t
     {
         const value_t m_id;
@@ -54,12 +88,12 @@ namespace rpc_light
             return m_named_params;
         }
 
-        const inline array_t get_params_arr() const
+        const inline array_t &get_params_arr() const
         {
             return std::get<array_t>(m_params);
         }
 
-        const inline struct_t get_params_str() const
+        const inline struct_t &get_params_str() const
         {
             return std::get<struct_t>(m_params);
         }
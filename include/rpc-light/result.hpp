@@ -51,17 +51,17 @@ namespace rpc_light
             return m_is_batch;
         }
 
-        const inline batch_t get_batch() const
+        const inline batch_t &get_batch() const
         {
             return std::get<batch_t>(m_response);
         }
 
-        const inline response_t get_response() const
+        const inline response_t &get_response() const
         {
             return std::get<response_t>(m_response);
         }
 
-        const inline std::string get_response_str() const
+        const inline std::string &get_response_str() const
         {
             return m_string;
         }
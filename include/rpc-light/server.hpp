@@ -3,31 +3,31 @@
 #include "exceptions.hpp"
 #include "aliases.hpp"
 #include "value.hpp"
-#include "reader.hpp"
-#include "writer.hpp"
+#include "codec.hpp"
 #include "dispatcher.hpp"
 #include "result.hpp"
 #include "response.hpp"
+#include "executor.hpp"
 
 #include <string>
 #include <future>
 #include <vector>
+#include <memory>
+#include <optional>
+#include <atomic>
+#include <functional>
 #include <mutex>
-#include <condition_variable>
-#include <chrono>
-#include <queue>
 
 namespace rpc_light
 {
-    class server_t
+    //codec_type selects the wire formats the server accepts, see codec.hpp
+    template <typename codec_type = auto_codec_t>
+    class basic_server_t
     {
-        std::mutex m_mutex;
         dispatcher_t m_dispatcher;
-        std::future<void> m_worker;
-        std::condition_variable event;
-        std::queue<std::pair<const std::string, std::promise<const result_t>>> m_queue;
-
-        bool worker_running = false;
+        executor_t m_executor;
+        //optional pool that runs messages passed to notify, so they never take a worker from calls
+        std::unique_ptr<executor_t> m_notifier;
 
         const response_t
         handle_error(const std::exception_ptr &e_ptr, const value_t &id = null_t()) const
@@ -70,83 +70,532 @@ namespace rpc_light
             }
         }
 
-        void start_worker()
+        using completion_t = std::function<void(const result_t &)>;
+
+        struct batch_state_t
+        {
+            const std::vector<std::string> batch;
+            std::vector<std::optional<result_t>> results;
+            std::atomic<std::size_t> remaining;
+            const completion_t done;
+
+            batch_state_t(std::vector<std::string> &&batch, completion_t &&done)
+                : batch(std::move(batch)), results(this->batch.size()),
+                  remaining(this->batch.size()), done(std::move(done)) {}
+        };
+
+        //elements may complete on any worker and in any order, the last one to finish assembles the batch
+        //format_type is the single format codec the message was received in, responses are written with it as well
+        template <typename format_type>
+        void get_batch_result(std::vector<std::string> &&batch, completion_t &&done)
         {
-            m_worker = std::async(std::launch::async, &server_t::worker_proc, this);
-            worker_running = true;
+            auto state = std::make_shared<batch_state_t>(std::move(batch), std::move(done));
+            auto batch_size = state->batch.size();
+            auto spawn = batch_size > 1 && m_executor.concurrency() > 1;
+            for (std::size_t i = 0; i < batch_size; i++)
+            {
+                auto element = [this, state, i] {
+                    get_result<format_type>(state->batch[i], [this, state, i](const result_t &result) {
+                        state->results[i].emplace(result);
+                        if (state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                            finish_batch<format_type>(*state);
+                    });
+                };
+                //elements land on this worker's stack where idle workers can steal them
+                if (spawn)
+                    m_executor.post(element);
+
+                else
+                    element();
+            }
         }
 
-        void worker_proc()
+        template <typename format_type>
+        void finish_batch(batch_state_t &state)
         {
-            while (true)
+            std::optional<result_t> result;
+            try
             {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (!event.wait_for(lock, std::chrono::seconds(5), [&] { return !m_queue.empty(); }))
+                //elements are already serialized, the batch response joins them instead of encoding them again
+                std::vector<response_t> responses;
+                responses.reserve(state.results.size());
+                std::string output;
+                typename format_type::batch_writer_t writer;
+                bool has_error = false;
+                for (auto &e : state.results)
                 {
-                    worker_running = false;
-                    return;
+                    if (e->has_error())
+                        has_error = true;
+
+                    //notifications have no response
+                    if (e->has_response())
+                        responses.push_back(e->get_response());
+
+                    if (auto &element = e->get_response_str(); !element.empty())
+                    {
+                        writer.next(output);
+                        output.append(element);
+                    }
                 }
-                auto& pair = m_queue.front();
-                pair.second.set_value(get_result(pair.first));
-                m_queue.pop();
+                writer.finish(output);
+                result.emplace(responses, output, has_error);
+            }
+            catch (...)
+            {
+                auto error = handle_error(std::current_exception());
+                result.emplace(error, format_type::serialize_response(error), true);
             }
+            state.done(*result);
+        }
+
+        //receives serialized output, last is set on the final call. has_error covers everything written so far
+        using chunk_t = std::function<void(const std::string_view &, bool last, bool has_error)>;
+
+        template <typename format_type>
+        struct stream_state_t
+        {
+            const std::vector<std::string> batch;
+            std::atomic<std::size_t> remaining;
+            const bool stream;
+            const chunk_t done;
+            std::mutex mutex;
+            typename format_type::batch_writer_t writer;
+            std::string output;
+            bool has_error = false;
+
+            stream_state_t(std::vector<std::string> &&batch, chunk_t &&done, const bool &stream)
+                : batch(std::move(batch)), remaining(this->batch.size()), stream(stream), done(std::move(done)) {}
+        };
+
+        //serializes one request without keeping its response_t, coroutine methods and nested batches take the full path
+        template <typename format_type, typename callback_type>
+        void get_element(const std::string_view &request_string, callback_type &&done)
+        {
+            std::string output;
+            bool has_error = false;
+            if (write_response<format_type>(request_string, output, has_error))
+                return done(std::string_view(output), has_error);
+
+            get_result<format_type>(request_string, [done = std::move(done)](const result_t &result) mutable {
+                done(std::string_view(result.get_response_str()), result.has_error());
+            });
         }
 
-        const result_t get_result(const std::string request_string)
+        //batch elements are serialized as each one completes and appended to the output, no response_t is kept.
+        //with stream set and a codec that can send a batch before knowing its length, the output is handed on
+        //after every element so only one element is buffered at a time, otherwise it is handed on once at the end.
+        //chunks are delivered one at a time in completion order, which the batch response does not have to follow
+        template <typename format_type>
+        void get_stream(const std::string_view &request_string, chunk_t &&done, const bool &stream)
         {
+            std::vector<std::string> batch;
             try
             {
-                if (auto batch = reader::get_batch(request_string); !batch.empty())
+                batch = format_type::get_batch(request_string);
+            }
+            catch (...)
+            {
+                std::string output;
+                format_type::write_error(output, handle_error(std::current_exception()));
+                return done(output, true, true);
+            }
+
+            if (batch.empty())
+                return get_element<format_type>(request_string, [done = std::move(done)](const std::string_view &response, bool has_error) {
+                    done(response, true, has_error);
+                });
+
+            auto state = std::make_shared<stream_state_t<format_type>>(std::move(batch), std::move(done), stream);
+            auto batch_size = state->batch.size();
+            auto spawn = batch_size > 1 && m_executor.concurrency() > 1;
+            for (std::size_t i = 0; i < batch_size; i++)
+            {
+                auto element = [this, state, i] {
+                    get_element<format_type>(state->batch[i], [state](const std::string_view &response, bool has_error) {
+                        append_element(*state, response, has_error);
+                    });
+                };
+                if (spawn)
+                    m_executor.post(element);
+
+                else
+                    element();
+            }
+        }
+
+        template <typename format_type>
+        static void append_element(stream_state_t<format_type> &state, const std::string_view &response, const bool &has_error)
+        {
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.has_error = state.has_error || has_error;
+                //notifications have no response
+                if (!response.empty())
                 {
-                    std::vector<response_t> responses;
-                    bool has_error = false;
-                    for (auto &e : batch)
+                    state.writer.next(state.output);
+                    state.output.append(response);
+                    if (state.stream && format_type::batch_writer_t::streams)
                     {
-                        auto result = get_result(e);
-                        if (result.has_error())
-                            has_error = true;
-
-                        responses.push_back(result.get_response());
+                        state.done(state.output, false, state.has_error);
+                        state.output.clear();
                     }
-                    return result_t(responses, writer::serialize_batch_response(responses), has_error);
                 }
-                auto request = reader::deserialize_request(request_string);
+            }
+
+            if (state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            {
+                std::unique_lock<std::mutex> lock(state.mutex);
+                state.writer.finish(state.output);
+                state.done(state.output, true, state.has_error);
+            }
+        }
+
+#ifdef RPC_LIGHT_COROUTINES
+        //suspends while the bound coroutine is pending and completes the request back on a worker
+        template <typename format_type>
+        detached_t get_async_result(const request_t request, const completion_t done)
+        {
+            std::optional<result_t> result;
+            std::exception_ptr e_ptr;
+            try
+            {
+                auto response = co_await m_dispatcher.invoke_async(request);
+                result.emplace(response, format_type::serialize_response(response));
+            }
+            catch (...)
+            {
+                e_ptr = std::current_exception();
+            }
+
+            if (!m_executor.on_worker())
+                co_await m_executor.schedule();
+
+            //a notification is never answered, not even with an error
+            if (request.is_notification())
+                result.emplace();
+
+            else if (e_ptr)
+            {
+                auto error = handle_error(e_ptr, request.get_id());
+                result.emplace(error, format_type::serialize_response(error), true);
+            }
+            done(*result);
+        }
+#endif
+
+        //serves calls to idempotent methods from their cache, on a miss the method runs and its result is
+        //serialized once and stored. returns null for methods without a cache and for notifications
+        template <typename format_type>
+        std::shared_ptr<const cache_entry_t> get_cached(const request_t &request)
+        {
+            if (request.is_notification())
+                return nullptr;
+
+            //the cache belongs to the current version of the method table
+            auto guard = m_dispatcher.read();
+            auto cache = m_dispatcher.get_cache(request.get_method());
+            if (!cache)
+                return nullptr;
+
+            auto key = result_cache_t::make_key(static_cast<uint8_t>(format_type::default_format), request);
+            if (auto entry = cache->find(key))
+                return entry;
+
+            auto value = m_dispatcher.call(request);
+            auto fragment = format_type::serialize_value(value);
+            return cache->store(std::move(key), std::move(value), std::move(fragment));
+        }
+
+        template <typename format_type>
+        void get_result(const std::string_view &request_string, completion_t &&done)
+        {
+            std::optional<result_t> result;
+            try
+            {
+                if (auto batch = format_type::get_batch(request_string); !batch.empty())
+                    return get_batch_result<format_type>(std::move(batch), std::move(done));
+
+                auto request = format_type::deserialize_request(request_string, &m_dispatcher);
+#ifdef RPC_LIGHT_COROUTINES
+                if (m_dispatcher.is_async(request.get_method()))
+                    return (void)get_async_result<format_type>(request, std::move(done));
+#endif
                 try
                 {
-                    auto response = m_dispatcher.invoke(request);
-                    return result_t(response, writer::serialize_response(response));
+                    //a notification has no response to build, its value is dropped unwrapped
+                    if (request.is_notification())
+                    {
+                        m_dispatcher.notify(request);
+                        result.emplace();
+                    }
+                    else if (auto entry = get_cached<format_type>(request))
+                    {
+                        std::string output;
+                        format_type::write_raw_result(output, entry->fragment, request.get_id());
+                        result.emplace(response_t(entry->value, request.get_id()), output);
+                    }
+                    else
+                    {
+                        auto response = m_dispatcher.invoke(request);
+                        result.emplace(response, format_type::serialize_response(response));
+                    }
                 }
                 catch (...)
                 {
-                    auto error = handle_error(std::current_exception(), request.get_id());
-                    return result_t(error, writer::serialize_response(error), true);
+                    //a notification is never answered, not even with an error
+                    if (request.is_notification())
+                        result.emplace();
+
+                    else
+                    {
+                        auto error = handle_error(std::current_exception(), request.get_id());
+                        result.emplace(error, format_type::serialize_response(error), true);
+                    }
                 }
             }
             catch (...)
             {
                 auto error = handle_error(std::current_exception());
-                return result_t(error, writer::serialize_response(error), true);
+                result.emplace(error, format_type::serialize_response(error), true);
             }
+            done(*result);
         }
 
-    public:
-        auto handle_request(const std::string &request_string)
+        //serializes the response to a single synchronous request straight into output without building
+        //response_t or result_t, returns false without writing when the request needs the full path
+        template <typename format_type>
+        bool write_response(const std::string_view &request_string, std::string &output, bool &has_error)
         {
-            std::future<const result_t> result;
+            if (format_type::is_batch(request_string))
+                return false;
+
+            std::optional<request_t> request;
+            try
+            {
+                request.emplace(format_type::deserialize_request(request_string, &m_dispatcher));
+            }
+            catch (...)
+            {
+                format_type::write_error(output, handle_error(std::current_exception()));
+                has_error = true;
+                return true;
+            }
+#ifdef RPC_LIGHT_COROUTINES
+            if (m_dispatcher.is_async(request->get_method()))
+                return false;
+#endif
+            try
             {
-                std::unique_lock<std::mutex> lock(m_mutex);
-                if (!worker_running)
-                    start_worker();
+                if (auto entry = get_cached<format_type>(*request))
+                    format_type::write_raw_result(output, entry->fragment, request->get_id());
 
-                result = m_queue.emplace(request_string, std::promise<const result_t>()).second.get_future();
+                else
+                {
+                    auto value = m_dispatcher.call(*request);
+                    if (!request->is_notification())
+                        format_type::write_result(output, value, request->get_id());
+                }
+            }
+            catch (...)
+            {
+                output.clear();
+                //a notification is never answered, not even with an error
+                if (!request->is_notification())
+                {
+                    format_type::write_error(output, handle_error(std::current_exception(), request->get_id()));
+                    has_error = true;
+                }
             }
-            event.notify_all();
+            return true;
+        }
+
+        //runs a message without producing a response. calls in it still run, their values and any errors
+        //are dropped since no one is waiting for them
+        template <typename format_type>
+        void run_notification(const std::string_view &request_string)
+        {
+            try
+            {
+                //elements run in place, so a batch stays on the pool it was posted to
+                if (auto batch = format_type::get_batch(request_string); !batch.empty())
+                {
+                    for (auto &e : batch)
+                        run_notification<format_type>(e);
+
+                    return;
+                }
+
+                auto request = format_type::deserialize_request(request_string, &m_dispatcher);
+#ifdef RPC_LIGHT_COROUTINES
+                if (m_dispatcher.is_async(request.get_method()))
+                    return (void)get_async_result<format_type>(request, [](const result_t &) {});
+#endif
+                m_dispatcher.notify(request);
+            }
+            catch (...)
+            {
+            }
+        }
+
+        static inline thread_local std::string t_output;
+
+        //chosen before the message is parsed, from the method's priority or else from whether it is a notification
+        const priority_t get_priority(const std::string_view &request_string) const
+        {
+            auto hint = codec_type::visit(codec_type::detect_format(request_string), [&](auto codec) {
+                return decltype(codec)::peek(request_string);
+            });
+            if (!hint.method.empty())
+                if (auto priority = m_dispatcher.get_priority(hint.method))
+                    return *priority;
+
+            return hint.notification ? priority_t::low : priority_t::normal;
+        }
+
+    public:
+        basic_server_t(const executor_config_t &config = executor_config_t())
+            : m_executor(config)
+        {
+            m_executor.start();
+        }
+
+        //serves a copy of dispatcher, methods added to the original afterwards are not seen
+        basic_server_t(const dispatcher_t &dispatcher, const executor_config_t &config = executor_config_t())
+            : m_dispatcher(dispatcher), m_executor(config)
+        {
+            m_executor.start();
+        }
+
+        //messages passed to notify run on a second pool configured by notification_config
+        basic_server_t(const executor_config_t &config, const executor_config_t &notification_config)
+            : m_executor(config), m_notifier(std::make_unique<executor_t>(notification_config))
+        {
+            m_executor.start();
+            m_notifier->start();
+        }
+
+        //workers are started on construction, stop drains queued work and joins the workers
+        void start()
+        {
+            m_executor.start();
+            if (m_notifier)
+                m_notifier->start();
+        }
+
+        void stop()
+        {
+            if (m_notifier)
+                m_notifier->stop();
+
+            m_executor.stop();
+        }
+
+        //fire and forget, for messages whose sender wants no response. no promise, result_t or response_t is
+        //created and return values are dropped without being wrapped. the message runs on the notification
+        //pool when the server has one, otherwise in the low lane of the workers
+        void notify(std::string request_string)
+        {
+            auto work = [this, request_string = std::move(request_string)] {
+                codec_type::visit(codec_type::detect_format(request_string), [&](auto codec) {
+                    run_notification<decltype(codec)>(request_string);
+                });
+            };
+            if (m_notifier)
+                m_notifier->post(priority_t::low, std::move(work));
+
+            else
+                m_executor.post(priority_t::low, std::move(work));
+        }
+
+        auto handle_request(std::string request_string)
+        {
+            auto promise = std::make_shared<std::promise<const result_t>>();
+            auto result = promise->get_future();
+            handle_request(std::move(request_string), [promise](const result_t &result) { promise->set_value(result); });
             return result;
         }
 
+        //with more than one accepted format the codec picks the format per message and the response is
+        //encoded the same way, so a transport serving a connection in one format always answers in that format.
+        //the callback runs on a worker and receives one of
+        //  const result_t &                    the full result with every response_t of a batch
+        //  std::string_view                    just the serialized response, no result_t or response_t is built
+        //  std::string_view, bool last         the serialized response in chunks, a json batch response is handed
+        //                                      on element by element as they complete so it can be sent early
+        //string_view arguments view buffers owned by the server and are only valid during the call
+        //the request is queued in the lane of its priority, see method_options_t::priority
+        template <typename callback_type>
+        void handle_request(std::string request_string, callback_type callback)
+        {
+            auto priority = get_priority(request_string);
+            m_executor.post(priority, [this, request_string = std::move(request_string), callback = std::move(callback)]() mutable {
+                codec_type::visit(codec_type::detect_format(request_string), [&](auto codec) {
+                    using format_type = decltype(codec);
+                    if constexpr (std::is_invocable_v<callback_type &, const result_t &>)
+                        get_result<format_type>(request_string, std::move(callback));
+
+                    else
+                    {
+                        constexpr bool chunked = std::is_invocable_v<callback_type &, std::string_view, bool>;
+                        bool has_error = false;
+                        t_output.clear();
+                        if (write_response<format_type>(request_string, t_output, has_error))
+                        {
+                            if constexpr (chunked)
+                                return (void)callback(std::string_view(t_output), true);
+
+                            else
+                                return (void)callback(std::string_view(t_output));
+                        }
+
+                        get_stream<format_type>(request_string, [callback = std::move(callback)](const std::string_view &chunk, bool last, bool) mutable {
+                            if constexpr (chunked)
+                                callback(chunk, last);
+
+                            else
+                                callback(chunk);
+                        },
+                                                chunked);
+                    }
+                });
+            });
+        }
+
+        //handles the request on the calling thread and serializes the response into output, which is cleared
+        //first so it can be reused across calls, returns whether the response carries an error.
+        //batches and coroutine methods take the full path and the calling thread waits for them,
+        //so this must not be called from the server's own workers
+        const bool handle_request_into(const std::string_view &request_string, std::string &output)
+        {
+            output.clear();
+            return codec_type::visit(codec_type::detect_format(request_string), [&](auto codec) {
+                using format_type = decltype(codec);
+                bool has_error = false;
+                if (write_response<format_type>(request_string, output, has_error))
+                    return has_error;
+
+                std::promise<void> promise;
+                get_stream<format_type>(request_string, [&](const std::string_view &chunk, bool, bool chunk_error) {
+                    output = chunk;
+                    has_error = chunk_error;
+                    promise.set_value();
+                },
+                                        false);
+                promise.get_future().wait();
+                return has_error;
+            });
+        }
+
+        inline executor_t &get_executor()
+        {
+            return m_executor;
+        }
+
         inline dispatcher_t &get_dispatcher()
         {
             return m_dispatcher;
         }
     };
+
+    using server_t = basic_server_t<>;
 } // namespace rpc_light
\ No newline at end of file
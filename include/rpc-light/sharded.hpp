@@ -0,0 +1,206 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "codec.hpp"
+#include "dispatcher.hpp"
+#include "result.hpp"
+#include "executor.hpp"
+#include "server.hpp"
+
+#include <string>
+#include <string_view>
+#include <future>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+namespace rpc_light
+{
+    enum class shard_route_t
+    {
+        //requests of one connection stay on one shard, in order and on warm caches
+        connection,
+        //calls of one method stay on one shard, so its result cache and in-flight calls are not split
+        method
+    };
+
+    struct shard_config_t
+    {
+        //number of shards, 0 uses one per hardware thread
+        unsigned int shards = 0;
+        shard_route_t route = shard_route_t::connection;
+        //opt-in rebalancing, a request is moved off its shard when that shard has this many more requests in
+        //flight than the least loaded one. the move is made when the request is submitted, so a moved request
+        //may overtake earlier requests of its connection and runs away from its method's cache and flight
+        //group. 0, the default, never moves requests
+        std::size_t steal_threshold = 0;
+        //applied to every shard's worker, see executor_config_t
+        unsigned int spin_count = 4096;
+        std::size_t queue_capacity = 4096;
+        //optional cpu index per shard, shards past the end of the list are not pinned
+        std::vector<int> cpu_affinity;
+    };
+
+    //a server split into shards that share nothing while serving. every shard is a server with one worker,
+    //its own queue and its own copy of the method table, so the hot path never touches another core's data.
+    //methods are added to the dispatcher returned by get_dispatcher, start() then copies the table into each
+    //shard and later changes to it are not seen. each shard keeps its own result caches and flight groups
+    template <typename codec_type = auto_codec_t>
+    class basic_sharded_server_t
+    {
+        struct alignas(64) shard_t
+        {
+            std::unique_ptr<basic_server_t<codec_type>> server;
+            std::atomic<std::size_t> pending{0};
+        };
+
+        //counts the request as finished on the first call, a chunked callback is called more than once
+        template <typename callback_type>
+        struct counted_t
+        {
+            std::atomic<std::size_t> *pending;
+            callback_type callback;
+
+            template <typename... args_type>
+            auto operator()(args_type &&... args) -> decltype(std::declval<callback_type &>()(std::forward<args_type>(args)...))
+            {
+                if (pending)
+                {
+                    pending->fetch_sub(1, std::memory_order_relaxed);
+                    pending = nullptr;
+                }
+                return callback(std::forward<args_type>(args)...);
+            }
+        };
+
+        const shard_config_t m_config;
+        dispatcher_t m_dispatcher;
+        std::vector<std::unique_ptr<shard_t>> m_shards;
+
+        shard_t &route(const std::size_t &connection, const std::string_view &request_string)
+        {
+            if (m_shards.empty())
+                throw ex_internal_error("Sharded server not started.");
+
+            auto key = connection;
+            if (m_config.route == shard_route_t::method)
+            {
+                //found by a byte scan, for a batch it is the first method. a wrong match only places the request
+                //on another shard
+                auto hint = codec_type::visit(codec_type::detect_format(request_string), [&](auto codec) {
+                    return decltype(codec)::peek(request_string);
+                });
+                if (!hint.method.empty())
+                    key = std::hash<std::string_view>()(hint.method);
+            }
+
+            auto size = m_shards.size();
+            auto *home = m_shards[key % size].get();
+            auto load = home->pending.load(std::memory_order_relaxed);
+            if (m_config.steal_threshold == 0 || load < m_config.steal_threshold)
+                return *home;
+
+            //the other shards are only read once the home shard is backed up
+            auto *target = home;
+            auto least = load;
+            for (auto &e : m_shards)
+                if (auto pending = e->pending.load(std::memory_order_relaxed); pending < least)
+                {
+                    least = pending;
+                    target = e.get();
+                }
+
+            return load - least >= m_config.steal_threshold ? *target : *home;
+        }
+
+    public:
+        basic_sharded_server_t(const shard_config_t &config = shard_config_t())
+            : m_config(config) {}
+
+        basic_sharded_server_t(const basic_sharded_server_t &) = delete;
+        basic_sharded_server_t &operator=(const basic_sharded_server_t &) = delete;
+
+        //freezes the method table into the shards and starts their workers, once stopped the shards are
+        //started again with the table they already have
+        void start()
+        {
+            if (!m_shards.empty())
+            {
+                for (auto &e : m_shards)
+                    e->server->start();
+
+                return;
+            }
+
+            auto shards = m_config.shards;
+            if (shards == 0)
+                shards = std::max(1u, std::thread::hardware_concurrency());
+
+            m_shards.reserve(shards);
+            for (unsigned int i = 0; i < shards; i++)
+            {
+                executor_config_t executor_config;
+                executor_config.threads = 1;
+                executor_config.spin_count = m_config.spin_count;
+                executor_config.queue_capacity = m_config.queue_capacity;
+                if (i < m_config.cpu_affinity.size())
+                    executor_config.cpu_affinity.push_back(m_config.cpu_affinity[i]);
+
+                auto &shard = *m_shards.emplace_back(std::make_unique<shard_t>());
+                shard.server = std::make_unique<basic_server_t<codec_type>>(m_dispatcher, executor_config);
+            }
+        }
+
+        void stop()
+        {
+            for (auto &e : m_shards)
+                e->server->stop();
+        }
+
+        //connection is any stable key of the transport's connection, the request is served on that
+        //connection's shard unless routed by method. see basic_server_t::handle_request for the callbacks
+        auto handle_request(const std::size_t &connection, std::string request_string)
+        {
+            auto promise = std::make_shared<std::promise<const result_t>>();
+            auto result = promise->get_future();
+            handle_request(connection, std::move(request_string), [promise](const result_t &result) { promise->set_value(result); });
+            return result;
+        }
+
+        template <typename callback_type>
+        void handle_request(const std::size_t &connection, std::string request_string, callback_type callback)
+        {
+            auto &shard = route(connection, request_string);
+            shard.pending.fetch_add(1, std::memory_order_relaxed);
+            shard.server->handle_request(std::move(request_string), counted_t<callback_type>{&shard.pending, std::move(callback)});
+        }
+
+        //see basic_server_t::notify, notifications are not counted towards a shard's load
+        void notify(const std::size_t &connection, std::string request_string)
+        {
+            route(connection, request_string).server->notify(std::move(request_string));
+        }
+
+        const inline std::size_t shard_count() const
+        {
+            return m_shards.size();
+        }
+
+        //the running server of one shard, e.g. to inspect its caches
+        inline basic_server_t<codec_type> &get_shard(const std::size_t &index)
+        {
+            return *m_shards.at(index)->server;
+        }
+
+        inline dispatcher_t &get_dispatcher()
+        {
+            return m_dispatcher;
+        }
+    };
+
+    using sharded_server_t = basic_sharded_server_t<>;
+} // namespace rpc_light
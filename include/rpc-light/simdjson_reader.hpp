@@ -0,0 +1,465 @@
+#pragma once
+
+#include "exceptions.hpp"
+#include "aliases.hpp"
+#include "value.hpp"
+#include "request.hpp"
+#include "response.hpp"
+
+#include <simdjson.h>
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <cstring>
+#include <cstdint>
+
+namespace rpc_light
+{
+    //on-demand backend, values are decoded straight from the input into value_t without building a dom first.
+    //messages are validated and reported with the same errors as the rapidjson reader
+    namespace simdjson_reader
+    {
+        namespace ondemand = simdjson::ondemand;
+
+        //simdjson reads past the end of the input, messages are copied into a padded per-thread buffer
+        class context_t
+        {
+            static inline thread_local ondemand::parser t_parser{simdjson::SIMDJSON_MAXSIZE_BYTES};
+            static inline thread_local std::string t_buffer;
+
+        public:
+            static ondemand::document iterate(const std::string_view &str)
+            {
+                t_buffer.resize(str.size() + simdjson::SIMDJSON_PADDING);
+                std::memcpy(t_buffer.data(), str.data(), str.size());
+                return t_parser.iterate(simdjson::padded_string_view(t_buffer.data(), str.size(), t_buffer.size()));
+            }
+        };
+
+        const value_t get_id_obj(ondemand::value id)
+        {
+            switch (ondemand::json_type(id.type()))
+            {
+            case ondemand::json_type::string:
+                return std::string(std::string_view(id.get_string()));
+
+            case ondemand::json_type::number:
+            {
+                if (ondemand::number_type(id.get_number_type()) != ondemand::number_type::signed_integer)
+                    break;
+
+                int64_t number = id.get_int64();
+                if (number >= INT32_MIN && number <= INT32_MAX)
+                    return (int)number;
+
+                return number;
+            }
+            case ondemand::json_type::null:
+                if (bool(id.is_null()))
+                    return null_t();
+
+                break;
+
+            default:
+                break;
+            }
+            throw ex_bad_request("Invalid id type.");
+        }
+
+        value_t get_value_obj(ondemand::value value)
+        {
+            switch (ondemand::json_type(value.type()))
+            {
+            case ondemand::json_type::null:
+                if (bool(value.is_null()))
+                    return null_t();
+
+                break;
+
+            case ondemand::json_type::boolean:
+                return bool(value.get_bool());
+
+            case ondemand::json_type::object:
+            {
+                struct_t data;
+                for (ondemand::field field : value.get_object())
+                {
+                    std::string_view key = field.unescaped_key();
+                    data.emplace(key, get_value_obj(field.value()));
+                }
+                return data;
+            }
+            case ondemand::json_type::array:
+            {
+                array_builder_t array;
+                for (ondemand::value e : value.get_array())
+                {
+                    if (ondemand::json_type(e.type()) != ondemand::json_type::number)
+                        array.push_value(get_value_obj(e));
+
+                    else if (ondemand::number_type(e.get_number_type()) == ondemand::number_type::signed_integer)
+                        array.push_int(e.get_int64());
+
+                    else
+                        array.push_double(e.get_double());
+                }
+                return array.finish();
+            }
+            case ondemand::json_type::string:
+                return std::string(std::string_view(value.get_string()));
+
+            case ondemand::json_type::number:
+            {
+                switch (ondemand::number_type(value.get_number_type()))
+                {
+                case ondemand::number_type::signed_integer:
+                {
+                    int64_t number = value.get_int64();
+                    if (number >= INT32_MIN && number <= INT32_MAX)
+                        return (int)number;
+
+                    return number;
+                }
+                default:
+                    return double(value.get_double());
+                }
+            }
+            default:
+                break;
+            }
+            throw ex_bad_request("Invalid object type.");
+        }
+
+        //members of an on-demand object, a member whose value is not read is skipped when the next one is reached
+        class member_reader_t : public object_reader_t
+        {
+            ondemand::object_iterator m_iter, m_end;
+            std::optional<ondemand::field> m_field;
+
+        public:
+            member_reader_t(ondemand::object object) : m_iter(object.begin()), m_end(object.end()) {}
+
+            bool next(std::string_view &key) override
+            {
+                if (m_field)
+                    ++m_iter;
+
+                if (!(m_iter != m_end))
+                    return false;
+
+                m_field.emplace(*m_iter);
+                key = m_field->unescaped_key();
+                return true;
+            }
+
+            value_t value() override
+            {
+                return get_value_obj(m_field->value());
+            }
+
+            bool object(const std::function<void(object_reader_t &)> &read) override
+            {
+                if (ondemand::json_type(m_field->value().type()) != ondemand::json_type::object)
+                    return false;
+
+                member_reader_t members(m_field->value().get_object());
+                read(members);
+                return true;
+            }
+
+            void skip() override {}
+        };
+
+        //positional params, objects at a position with a decoder are decoded by it. a param that does not
+        //convert is left null and fails when the method is bound, as it would have from a struct_t
+        array_t get_params_arr(ondemand::array params, const param_decoders_t &decoders)
+        {
+            array_t array;
+            std::size_t index = 0;
+            for (ondemand::value e : params)
+            {
+                if (index < decoders.size() && decoders[index] && ondemand::json_type(e.type()) == ondemand::json_type::object)
+                {
+                    try
+                    {
+                        member_reader_t members(e.get_object());
+                        array.push_back(decoders[index](members));
+                    }
+                    catch (const simdjson::simdjson_error &)
+                    {
+                        throw;
+                    }
+                    catch (...)
+                    {
+                        array.emplace_back(null_t());
+                    }
+                }
+                else
+                    array.push_back(get_value_obj(e));
+
+                index++;
+            }
+            return array;
+        }
+
+        //returns an empty batch for non-array input so the caller falls back to a single request
+        const std::vector<std::string> get_batch(const std::string_view &str)
+        {
+            std::vector<std::string> batch;
+            try
+            {
+                auto document = context_t::iterate(str);
+                if (ondemand::json_type(document.type()) != ondemand::json_type::array)
+                    return batch;
+
+                //elements are handed on as their raw text, nothing is re-serialized
+                for (ondemand::value e : document.get_array())
+                    batch.emplace_back(std::string_view(e.raw_json()));
+
+                if (!document.at_end())
+                    throw ex_parse_error("Batch parse error.");
+            }
+            catch (const simdjson::simdjson_error &)
+            {
+                throw ex_parse_error("Batch parse error.");
+            }
+            return batch;
+        }
+
+        //a document is not a value, so the text is wrapped in an array to reuse get_value_obj for scalars too
+        const value_t parse_value(const std::string_view &str)
+        {
+            std::string wrapped;
+            wrapped.reserve(str.size() + 2);
+            wrapped.push_back('[');
+            wrapped.append(str);
+            wrapped.push_back(']');
+            std::optional<value_t> value;
+            try
+            {
+                auto document = context_t::iterate(wrapped);
+                for (ondemand::value e : document.get_array())
+                {
+                    if (value)
+                        throw ex_parse_error("Value parse error.");
+
+                    value.emplace(get_value_obj(e));
+                }
+
+                if (!value || !document.at_end())
+                    throw ex_parse_error("Value parse error.");
+            }
+            catch (const simdjson::simdjson_error &)
+            {
+                throw ex_parse_error("Value parse error.");
+            }
+            return *value;
+        }
+
+        //with a lookup, positional params of reflected types are decoded as they are read. params that come
+        //before the method are set aside as text and read once the method is known
+        const request_t deserialize_request(const std::string_view &request_string, const param_lookup_t *lookup = nullptr)
+        {
+            std::optional<std::string> jrpc_version, method, deferred;
+            std::optional<value_t> json_params, id;
+            try
+            {
+                auto document = context_t::iterate(request_string);
+                if (ondemand::json_type(document.type()) != ondemand::json_type::object)
+                    throw ex_bad_request("Request was not an object.");
+
+                //single pass over the members, anything not consumed here is skipped by the parser
+                for (ondemand::field field : document.get_object())
+                {
+                    std::string_view key = field.unescaped_key();
+                    ondemand::value value = field.value();
+                    if (key == JSON_PROTO && !jrpc_version)
+                    {
+                        if (ondemand::json_type(value.type()) != ondemand::json_type::string)
+                            throw ex_bad_request("Invalid protocol.");
+
+                        jrpc_version = std::string_view(value.get_string());
+                    }
+                    else if (key == JSON_METHOD && !method)
+                    {
+                        if (ondemand::json_type(value.type()) != ondemand::json_type::string)
+                            throw ex_bad_request("Invalid method value.");
+
+                        method = std::string_view(value.get_string());
+                    }
+                    else if (key == JSON_PARAMS && !json_params)
+                    {
+                        auto type = ondemand::json_type(value.type());
+                        if (type != ondemand::json_type::array && type != ondemand::json_type::object)
+                            throw ex_bad_request();
+
+                        if (!lookup || type != ondemand::json_type::array)
+                            json_params = get_value_obj(value);
+
+                        else if (!method)
+                            deferred = std::string_view(value.raw_json());
+
+                        else if (auto decoders = lookup->find_decoders(*method))
+                            json_params = get_params_arr(value.get_array(), *decoders);
+
+                        else
+                            json_params = get_value_obj(value);
+                    }
+                    else if (key == JSON_ID && !id)
+                        id = get_id_obj(value);
+                }
+
+                if (!document.at_end())
+                    throw ex_parse_error("Request parse error.");
+
+                //the document is done with, its parser is reused for the params
+                if (deferred && method)
+                {
+                    auto params = context_t::iterate(*deferred);
+                    if (auto decoders = lookup->find_decoders(*method))
+                        json_params = get_params_arr(params.get_array(), *decoders);
+
+                    else
+                        json_params = get_value_obj(params.get_value());
+                }
+            }
+            catch (const simdjson::simdjson_error &)
+            {
+                throw ex_parse_error("Request parse error.");
+            }
+
+            if (!jrpc_version)
+                throw ex_bad_request("Invalid protocol.");
+
+            if (*jrpc_version != JSON_VER)
+                throw ex_bad_request("Invalid protocol version.");
+
+            if (!method)
+                throw ex_bad_request("Invalid method value.");
+
+            if (json_params)
+            {
+                if (json_params->is_array())
+                {
+                    if (!id)
+                        return request_t(*method, json_params->get_value<array_t>());
+
+                    return request_t(*method, json_params->get_value<array_t>(), *id);
+                }
+
+                if (!id)
+                    return request_t(*method, json_params->get_value<struct_t>());
+
+                return request_t(*method, json_params->get_value<struct_t>(), *id);
+            }
+
+            if (!id)
+                return request_t(*method);
+
+            return request_t(*method, *id);
+        }
+
+        const response_t deserialize_response(const std::string_view &response_string)
+        {
+            std::optional<std::string> jrpc_version, message;
+            std::optional<value_t> id, result, data;
+            std::optional<int> code;
+            bool has_error = false;
+            try
+            {
+                auto document = context_t::iterate(response_string);
+                if (ondemand::json_type(document.type()) != ondemand::json_type::object)
+                    throw ex_bad_request("Response was not an object.");
+
+                for (ondemand::field field : document.get_object())
+                {
+                    std::string_view key = field.unescaped_key();
+                    ondemand::value value = field.value();
+                    if (key == JSON_PROTO && !jrpc_version)
+                    {
+                        if (ondemand::json_type(value.type()) != ondemand::json_type::string)
+                            throw ex_bad_request("Invalid protocol.");
+
+                        jrpc_version = std::string_view(value.get_string());
+                    }
+                    else if (key == JSON_ID && !id)
+                        id = get_id_obj(value);
+
+                    else if (key == JSON_RESULT && !result)
+                        result = get_value_obj(value);
+
+                    else if (key == JSON_ERROR && !has_error)
+                    {
+                        has_error = true;
+                        if (ondemand::json_type(value.type()) != ondemand::json_type::object)
+                            throw ex_bad_request("Error was not an object.");
+
+                        for (ondemand::field error_field : value.get_object())
+                        {
+                            std::string_view error_key = error_field.unescaped_key();
+                            ondemand::value error_value = error_field.value();
+                            if (error_key == JSON_CODE && !code)
+                            {
+                                int64_t number;
+                                if (error_value.get_int64().get(number) || number < INT32_MIN || number > INT32_MAX)
+                                    throw ex_bad_request("Invalid error code value.");
+
+                                code = (int)number;
+                            }
+                            else if (error_key == JSON_MESSAGE && !message)
+                            {
+                                if (ondemand::json_type(error_value.type()) != ondemand::json_type::string)
+                                    throw ex_bad_request("Invalid error message value.");
+
+                                message = std::string_view(error_value.get_string());
+                            }
+                            else if (error_key == JSON_DATA && !data)
+                                data = get_value_obj(error_value);
+                        }
+                    }
+                }
+
+                if (!document.at_end())
+                    throw ex_parse_error("Response parse error.");
+            }
+            catch (const simdjson::simdjson_error &)
+            {
+                throw ex_parse_error("Response parse error.");
+            }
+
+            if (!jrpc_version)
+                throw ex_bad_request("Invalid protocol.");
+
+            if (*jrpc_version != JSON_VER)
+                throw ex_bad_request("Invalid protocol version.");
+
+            if (!id)
+                throw ex_bad_request("Missing response id.");
+
+            if (result)
+            {
+                if (has_error)
+                    throw ex_bad_request("Non-exclusive result.");
+
+                return response_t(*result, *id);
+            }
+            else if (has_error)
+            {
+                if (!code)
+                    throw ex_bad_request("Invalid error code value.");
+
+                if (!message)
+                    throw ex_bad_request("Invalid error message value.");
+
+                if (data)
+                    return response_t(*code, *message, *id, *data);
+
+                return response_t(*code, *message, *id);
+            }
+            else
+                throw ex_bad_request("Non-inclusive result.");
+        }
+    }; // namespace simdjson_reader
+} // namespace rpc_light
\ No newline at end of file
@@ -0,0 +1,155 @@
+#pragma once
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define RPC_LIGHT_COROUTINES
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <type_traits>
+
+namespace rpc_light
+{
+    template <typename value_type = void>
+    class task_t;
+
+    struct task_promise_base_t
+    {
+        std::coroutine_handle<> continuation = std::noop_coroutine();
+        std::exception_ptr exception;
+
+        //hands control back to whoever awaited the task
+        struct final_awaiter_t
+        {
+            bool await_ready() const noexcept { return false; }
+
+            template <typename promise_type>
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept
+            {
+                return handle.promise().continuation;
+            }
+
+            void await_resume() const noexcept {}
+        };
+
+        std::suspend_always initial_suspend() const noexcept { return {}; }
+        final_awaiter_t final_suspend() const noexcept { return {}; }
+        void unhandled_exception() { exception = std::current_exception(); }
+    };
+
+    template <typename value_type>
+    struct task_promise_t : task_promise_base_t
+    {
+        std::optional<value_type> value;
+
+        task_t<value_type> get_return_object();
+
+        template <typename return_type>
+        void return_value(return_type &&result)
+        {
+            value.emplace(std::forward<return_type>(result));
+        }
+    };
+
+    template <>
+    struct task_promise_t<void> : task_promise_base_t
+    {
+        task_t<void> get_return_object();
+        void return_void() {}
+    };
+
+    //lazily started coroutine result, runs when awaited and resumes the awaiting coroutine when done
+    template <typename value_type>
+    class task_t
+    {
+    public:
+        using promise_type = task_promise_t<value_type>;
+
+    private:
+        std::coroutine_handle<promise_type> m_handle;
+
+    public:
+        explicit task_t(const std::coroutine_handle<promise_type> &handle) : m_handle(handle) {}
+
+        task_t(task_t &&other) noexcept : m_handle(std::exchange(other.m_handle, nullptr)) {}
+
+        task_t &operator=(task_t &&other) noexcept
+        {
+            if (this != &other)
+            {
+                if (m_handle)
+                    m_handle.destroy();
+
+                m_handle = std::exchange(other.m_handle, nullptr);
+            }
+            return *this;
+        }
+
+        task_t(const task_t &) = delete;
+        task_t &operator=(const task_t &) = delete;
+
+        ~task_t()
+        {
+            if (m_handle)
+                m_handle.destroy();
+        }
+
+        bool await_ready() const noexcept
+        {
+            return m_handle.done();
+        }
+
+        std::coroutine_handle<> await_suspend(const std::coroutine_handle<> &awaiting) noexcept
+        {
+            m_handle.promise().continuation = awaiting;
+            return m_handle;
+        }
+
+        value_type await_resume()
+        {
+            auto &promise = m_handle.promise();
+            if (promise.exception)
+                std::rethrow_exception(promise.exception);
+
+            if constexpr (!std::is_void_v<value_type>)
+                return std::move(*promise.value);
+        }
+    };
+
+    template <typename value_type>
+    inline task_t<value_type> task_promise_t<value_type>::get_return_object()
+    {
+        return task_t<value_type>(std::coroutine_handle<task_promise_t>::from_promise(*this));
+    }
+
+    inline task_t<void> task_promise_t<void>::get_return_object()
+    {
+        return task_t<void>(std::coroutine_handle<task_promise_t>::from_promise(*this));
+    }
+
+    //eagerly started coroutine that nobody awaits, used to drive a task to completion from a worker
+    struct detached_t
+    {
+        struct promise_type
+        {
+            detached_t get_return_object() const noexcept { return {}; }
+            std::suspend_never initial_suspend() const noexcept { return {}; }
+            std::suspend_never final_suspend() const noexcept { return {}; }
+            void return_void() const noexcept {}
+            void unhandled_exception() const noexcept { std::terminate(); }
+        };
+    };
+
+    template <typename type>
+    struct is_task : std::false_type
+    {
+    };
+
+    template <typename value_type>
+    struct is_task<task_t<value_type>> : std::true_type
+    {
+    };
+} // namespace rpc_light
+
+#endif
\ No newline at end of file
@@ -3,11 +3,20 @@
 #include "exceptions.hpp"
 #include "aliases.hpp"
 #include "converter.hpp"
+#include "blob.hpp"
+#include "reflect.hpp"
+#include "raw.hpp"
 
 #include <variant>
 #include <string>
 #include <vector>
 #include <map>
+#include <limits>
+#include <type_traits>
+
+#if __cplusplus > 201703L && __has_include(<span>)
+#include <span>
+#endif
 
 namespace rpc_light
 {
@@ -21,9 +30,81 @@ namespace rpc_light
         {
         };
 
+        template <typename type>
+        struct is_vector : std::false_type
+        {
+        };
+        template <typename element_type>
+        struct is_vector<std::vector<element_type>> : std::true_type
+        {
+        };
+
+        template <typename type>
+        static constexpr bool is_number_v = std::is_arithmetic_v<type> && !std::is_same_v<type, bool>;
+
         using variant_t = std::variant<null_t, array_t,
                                        bool, double, int32_t, int64_t, std::string,
-                                       struct_t>;
+                                       struct_t, blob_t, double_array_t, int_array_t, object_t, raw_json_t>;
+
+        template <typename array_type>
+        static const array_t to_array(const array_type &numbers)
+        {
+            array_t array;
+            array.reserve(numbers.size());
+            for (auto &e : numbers)
+            {
+                if constexpr (std::is_same_v<array_type, int_array_t>)
+                {
+                    if (e >= std::numeric_limits<int32_t>::min() && e <= std::numeric_limits<int32_t>::max())
+                        array.emplace_back(static_cast<int32_t>(e));
+
+                    else
+                        array.emplace_back(e);
+                }
+                else
+                    array.emplace_back(e);
+            }
+            return array;
+        }
+
+        template <typename value_type>
+        static variant_t to_variant(const value_type &value)
+        {
+            if constexpr (is_reflected_v<value_type>)
+                return object_t(value);
+
+            else
+                return variant_t(value);
+        }
+
+        //members missing from the object keep the value the default constructed struct gives them
+        template <typename value_type>
+        static const value_type from_struct(const struct_t &members, const bool &allow_convert)
+        {
+            value_type object{};
+            std::apply([&](auto &&... fields) {
+                (read_field(object, members, fields, allow_convert), ...);
+            },
+                       reflect_t<value_type>::fields);
+            return object;
+        }
+
+        template <typename value_type, typename field_type>
+        static void read_field(value_type &object, const struct_t &members, const field_type &field, const bool &allow_convert)
+        {
+            if (auto iter = members.find(field.name); iter != members.end())
+                object.*field.member = iter->second.template get_value<typename field_type::type>(allow_convert);
+        }
+
+        struct struct_builder_t : field_visitor_t
+        {
+            struct_t members;
+
+            void field(const std::string_view &name, const value_t &value) override
+            {
+                members.emplace(name, value);
+            }
+        };
 
         variant_t m_value;
         static inline converter_t m_converter;
@@ -31,12 +112,29 @@ namespace rpc_light
     public:
         value_t() {}
 
+        //structs described with RPC_LIGHT_REFLECT are held as object_t, anything else as the matching alternative
         template <typename value_type>
-        value_t(const value_type &value) : m_value(value) {}
+        value_t(const value_type &value) : m_value(to_variant(value)) {}
 
+        //vectors of numbers keep their contiguous layout, integers are widened to int64_t and floats to double
         template <typename value_type>
         value_t(const std::vector<value_type> &value)
-            : m_value(array_t(value.begin(), value.end())) {}
+        {
+            if constexpr (std::is_floating_point_v<value_type>)
+                m_value = double_array_t(value.begin(), value.end());
+
+            else if constexpr (is_number_v<value_type>)
+                m_value = int_array_t(value.begin(), value.end());
+
+            else
+                m_value = array_t(value.begin(), value.end());
+        }
+
+        value_t(array_t &&value) : m_value(std::move(value)) {}
+
+        value_t(double_array_t &&value) : m_value(std::move(value)) {}
+
+        value_t(int_array_t &&value) : m_value(std::move(value)) {}
 
         template <typename value_type>
         value_t(const std::map<std::string, value_type> &value)
@@ -48,6 +146,12 @@ namespace rpc_light
             return std::holds_alternative<value_type>(m_value);
         }
 
+        //true for generic and typed arrays alike
+        const inline bool is_array() const
+        {
+            return is_type<array_t>() || is_type<double_array_t>() || is_type<int_array_t>();
+        }
+
         const inline bool has_value() const
         {
             return !std::holds_alternative<null_t>(m_value);
@@ -60,6 +164,77 @@ namespace rpc_light
                 if (std::holds_alternative<value_type>(m_value))
                     return std::get<value_type>(m_value);
 
+            //json has no binary type, blobs arrive as base64 strings and binary codecs deliver raw bytes
+            if constexpr (std::is_same_v<value_type, blob_t>)
+                if (auto str = std::get_if<std::string>(&m_value))
+                    return blob_t::from_base64(*str);
+
+            if constexpr (std::is_same_v<value_type, std::string>)
+                if (auto blob = std::get_if<blob_t>(&m_value))
+                    return std::string(blob->view());
+
+            //typed arrays and generic arrays convert into each other element by element
+            if constexpr (std::is_same_v<value_type, array_t>)
+            {
+                if (auto numbers = std::get_if<double_array_t>(&m_value))
+                    return to_array(*numbers);
+
+                if (auto numbers = std::get_if<int_array_t>(&m_value))
+                    return to_array(*numbers);
+            }
+            else if constexpr (is_vector<value_type>::value)
+            {
+                using element_type = typename value_type::value_type;
+                if constexpr (is_number_v<element_type>)
+                {
+                    if (auto numbers = std::get_if<double_array_t>(&m_value))
+                        return value_type(numbers->begin(), numbers->end());
+
+                    if (auto numbers = std::get_if<int_array_t>(&m_value))
+                        return value_type(numbers->begin(), numbers->end());
+                }
+
+                if (auto array = std::get_if<array_t>(&m_value))
+                {
+                    value_type values;
+                    values.reserve(array->size());
+                    for (auto &e : *array)
+                        values.emplace_back(e.get_value<element_type>(allow_convert));
+
+                    return values;
+                }
+            }
+            else if constexpr (is_reflected_v<value_type>)
+            {
+                if (auto object = std::get_if<object_t>(&m_value); object && object->is_type<value_type>())
+                    return object->get<value_type>();
+
+                if (auto members = std::get_if<struct_t>(&m_value))
+                    return from_struct<value_type>(*members, allow_convert);
+            }
+            else if constexpr (std::is_same_v<value_type, struct_t>)
+            {
+                if (auto object = std::get_if<object_t>(&m_value))
+                {
+                    struct_builder_t builder;
+                    object->visit(builder);
+                    return std::move(builder.members);
+                }
+            }
+#ifdef __cpp_lib_span
+            //spans view the stored array, they are only valid while this value is alive and unchanged
+            else if constexpr (std::is_same_v<value_type, std::span<const double>>)
+            {
+                if (auto numbers = std::get_if<double_array_t>(&m_value))
+                    return value_type(*numbers);
+            }
+            else if constexpr (std::is_same_v<value_type, std::span<const int64_t>>)
+            {
+                if (auto numbers = std::get_if<int_array_t>(&m_value))
+                    return value_type(*numbers);
+            }
+#endif
+
             if (allow_convert)
             {
                 value_type value;
@@ -96,4 +271,161 @@ namespace rpc_light
     };
     static inline auto &global_converter = value_t::get_converter();
 
+    template <typename type, typename>
+    object_t::object_t(const type &object)
+        : m_object(std::make_shared<const type>(object)), m_type(&typeid(type)),
+          m_size(std::tuple_size_v<std::decay_t<decltype(reflect_t<type>::fields)>>)
+    {
+        m_visit = [](const void *object, field_visitor_t &visitor) {
+            auto &members = *static_cast<const type *>(object);
+            std::apply([&](auto &&... fields) {
+                (visitor.field(fields.name, value_t(members.*fields.member)), ...);
+            },
+                       reflect_t<type>::fields);
+        };
+    }
+
+    template <typename type>
+    const type read_object(object_reader_t &reader);
+
+    template <typename type, typename field_type>
+    bool read_member(type &object, object_reader_t &reader, const std::string_view &key, const field_type &field)
+    {
+        if (key != field.name)
+            return false;
+
+        using member_type = typename field_type::type;
+        if constexpr (is_reflected_v<member_type>)
+            if (reader.object([&](object_reader_t &members) { object.*field.member = read_object<member_type>(members); }))
+                return true;
+
+        object.*field.member = reader.value().template get_value<member_type>();
+        return true;
+    }
+
+    //decodes a reflected struct from an encoded object without building a struct_t, each member is matched
+    //against the field list as it is read. unknown members are skipped and missing ones keep their default
+    template <typename type>
+    const type read_object(object_reader_t &reader)
+    {
+        type object{};
+        std::string_view key;
+        while (reader.next(key))
+        {
+            auto found = std::apply([&](auto &&... fields) {
+                return (read_member(object, reader, key, fields) || ...);
+            },
+                                    reflect_t<type>::fields);
+            if (!found)
+                reader.skip();
+        }
+        return object;
+    }
+
+    //collects array elements while parsing, arrays that only hold integers or only hold doubles end up in
+    //typed contiguous storage. an array mixing the two turns generic so every element keeps the type it was
+    //parsed with and a round trip writes it back unchanged
+    class array_builder_t
+    {
+        int_array_t m_ints;
+        double_array_t m_doubles;
+        array_t m_values;
+        std::size_t m_reserve = 0;
+        bool m_is_double = false, m_is_generic = false;
+
+        static void push_generic(array_t &values, const int64_t &value)
+        {
+            if (value >= std::numeric_limits<int32_t>::min() && value <= std::numeric_limits<int32_t>::max())
+                values.emplace_back(static_cast<int32_t>(value));
+
+            else
+                values.emplace_back(value);
+        }
+
+        void make_generic()
+        {
+            m_values.reserve(m_reserve);
+            if (m_is_double)
+                for (auto &e : m_doubles)
+                    m_values.emplace_back(e);
+
+            else
+                for (auto &e : m_ints)
+                    push_generic(m_values, e);
+
+            m_is_generic = true;
+        }
+
+    public:
+        void reserve(const std::size_t &size)
+        {
+            m_reserve = size;
+        }
+
+        void push_int(const int64_t &value)
+        {
+            if (!m_is_generic && m_is_double)
+                make_generic();
+
+            if (m_is_generic)
+                return push_generic(m_values, value);
+
+            if (m_ints.empty())
+                m_ints.reserve(m_reserve);
+
+            m_ints.push_back(value);
+        }
+
+        void push_double(const double &value)
+        {
+            if (!m_is_generic && !m_ints.empty())
+                make_generic();
+
+            if (m_is_generic)
+            {
+                m_values.emplace_back(value);
+                return;
+            }
+
+            if (!m_is_double)
+            {
+                m_doubles.reserve(m_reserve);
+                m_is_double = true;
+            }
+            m_doubles.push_back(value);
+        }
+
+        void push_value(value_t &&value)
+        {
+            if (value.is_type<int32_t>())
+                return push_int(value.get_value<int32_t>());
+
+            if (value.is_type<int64_t>())
+                return push_int(value.get_value<int64_t>());
+
+            if (value.is_type<double>())
+                return push_double(value.get_value<double>());
+
+            if (!m_is_generic)
+                make_generic();
+
+            m_values.push_back(std::move(value));
+        }
+
+        //empty arrays stay generic
+        value_t finish()
+        {
+            if (m_is_generic)
+                return std::move(m_values);
+
+            if (m_is_double)
+                return std::move(m_doubles);
+
+            if (m_ints.empty())
+                return array_t();
+
+            return std::move(m_ints);
+        }
+    };
+
 } // namespace rpc_light
\ No newline at end of file
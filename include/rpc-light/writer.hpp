@@ -1,5 +1,6 @@
 #pragma once
 
+#include "config.hpp"
 #include "exceptions.hpp"
 #include "aliases.hpp"
 #include "value.hpp"
@@ -10,225 +11,399 @@
 #include "../rapidjson/stringbuffer.h"
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <charconv>
+#include <algorithm>
 
 namespace rpc_light
 {
     namespace writer
     {
-        const rapidjson::Value
-        get_id_value(const value_t &id, rapidjson::MemoryPoolAllocator<rapidjson::CrtAllocator> &alloc)
+        //rapidjson output stream that appends to a caller owned string
+        class string_stream_t
+        {
+            std::string &m_string;
+
+        public:
+            using Ch = char;
+
+            string_stream_t(std::string &string) : m_string(string) {}
+
+            void Put(const char c)
+            {
+                m_string.push_back(c);
+            }
+
+            void Flush() {}
+        };
+
+        using string_writer_t = rapidjson::Writer<string_stream_t>;
+
+        //the writer is reused per thread so its level stack keeps its capacity between messages
+        string_writer_t &get_writer(string_stream_t &stream)
+        {
+            static thread_local string_writer_t t_writer;
+            t_writer.Reset(stream);
+            return t_writer;
+        }
+
+        //constant parts of every response, spliced in around the encoded values
+        constexpr std::string_view
+            RESULT_PREFIX = "{\"jsonrpc\":\"2.0\",\"result\":",
+            ERROR_PREFIX = "{\"jsonrpc\":\"2.0\",\"error\":{\"code\":",
+            MESSAGE_MEMBER = ",\"message\":",
+            DATA_MEMBER = ",\"data\":",
+            ID_MEMBER = ",\"id\":";
+
+        template <typename writer_type>
+        void write_id(writer_type &writer, const value_t &id)
         {
-            rapidjson::Value id_value;
             std::visit([&](auto &&arg) {
                 using type = std::decay_t<decltype(arg)>;
                 if constexpr (std::is_same_v<type, null_t>)
-                    id_value.SetNull();
+                    writer.Null();
 
                 else if constexpr (std::is_same_v<type, int32_t>)
-                    id_value.SetInt(id.get_value<int32_t>(false));
+                    writer.Int(arg);
 
                 else if constexpr (std::is_same_v<type, int64_t>)
-                    id_value.SetInt64(id.get_value<int64_t>(false));
+                    writer.Int64(arg);
 
                 else if constexpr (std::is_same_v<type, std::string>)
-                    id_value.SetString(id.get_value<std::string>(false).c_str(), alloc);
+                    writer.String(arg.data(), static_cast<rapidjson::SizeType>(arg.size()));
 
                 else
                     throw ex_internal_error("Invalid id type.");
             },
                        id.get_variant());
-            return id_value;
         }
 
-        const rapidjson::Value
-        get_obj_value(const value_t &obj, rapidjson::MemoryPoolAllocator<rapidjson::CrtAllocator> &alloc)
+        template <typename writer_type>
+        void write_value(writer_type &writer, const value_t &value);
+
+        //writes the members of a reflected struct as they are visited
+        template <typename writer_type>
+        class field_writer_t : public field_visitor_t
+        {
+            writer_type &m_writer;
+
+        public:
+            field_writer_t(writer_type &writer) : m_writer(writer) {}
+
+            void field(const std::string_view &name, const value_t &value) override
+            {
+                m_writer.Key(name.data(), static_cast<rapidjson::SizeType>(name.size()));
+                write_value(m_writer, value);
+            }
+        };
+
+        template <typename writer_type>
+        void write_value(writer_type &writer, const value_t &value)
         {
-            rapidjson::Value obj_value;
             std::visit([&](auto &&arg) {
                 using type = std::decay_t<decltype(arg)>;
                 if constexpr (std::is_same_v<type, null_t>)
-                    obj_value.SetNull();
+                    writer.Null();
 
                 else if constexpr (std::is_same_v<type, array_t>)
                 {
-                    obj_value.SetArray();
-                    auto arr = obj.get_value<array_t>();
-                    for (auto &e : arr)
-                        obj_value.PushBack(rapidjson::Value(get_obj_value(e, alloc), alloc), alloc);
+                    writer.StartArray();
+                    for (auto &e : arg)
+                        write_value(writer, e);
+
+                    writer.EndArray(static_cast<rapidjson::SizeType>(arg.size()));
                 }
                 else if constexpr (std::is_same_v<type, bool>)
-                    obj_value.SetBool(obj.get_value<bool>());
+                    writer.Bool(arg);
 
                 else if constexpr (std::is_same_v<type, double>)
-                    obj_value.SetDouble(obj.get_value<double>());
+                    writer.Double(arg);
 
                 else if constexpr (std::is_same_v<type, int32_t>)
-                    obj_value.SetInt(obj.get_value<int32_t>());
+                    writer.Int(arg);
 
                 else if constexpr (std::is_same_v<type, int64_t>)
-                    obj_value.SetInt64(obj.get_value<int64_t>());
+                    writer.Int64(arg);
 
                 else if constexpr (std::is_same_v<type, std::string>)
-                    obj_value.SetString(obj.get_value<std::string>().c_str(), alloc);
+                    writer.String(arg.data(), static_cast<rapidjson::SizeType>(arg.size()));
+
+                else if constexpr (std::is_same_v<type, double_array_t>)
+                {
+                    writer.StartArray();
+                    for (auto &e : arg)
+                        writer.Double(e);
+
+                    writer.EndArray(static_cast<rapidjson::SizeType>(arg.size()));
+                }
+                else if constexpr (std::is_same_v<type, int_array_t>)
+                {
+                    writer.StartArray();
+                    for (auto &e : arg)
+                        writer.Int64(e);
 
+                    writer.EndArray(static_cast<rapidjson::SizeType>(arg.size()));
+                }
+                else if constexpr (std::is_same_v<type, blob_t>)
+                {
+                    //base64 never needs escaping, so the quoted text is emitted as it is
+                    static thread_local std::string encoded;
+                    encoded.assign(1, '"');
+                    base64::encode(arg.data(), arg.size(), encoded);
+                    encoded.push_back('"');
+                    writer.RawValue(encoded.data(), encoded.size(), rapidjson::kStringType);
+                }
                 else if constexpr (std::is_same_v<type, struct_t>)
                 {
-                    obj_value.SetObject();
-                    auto strct = obj.get_value<struct_t>();
-                    for (auto &e : strct)
-                        obj_value.AddMember(rapidjson::Value(e.first.c_str(), alloc),
-                                            rapidjson::Value(get_obj_value(e.second, alloc)), alloc);
+                    writer.StartObject();
+                    for (auto &e : arg)
+                    {
+                        writer.Key(e.first.data(), static_cast<rapidjson::SizeType>(e.first.size()));
+                        write_value(writer, e.second);
+                    }
+                    writer.EndObject(static_cast<rapidjson::SizeType>(arg.size()));
+                }
+                else if constexpr (std::is_same_v<type, object_t>)
+                {
+                    writer.StartObject();
+                    field_writer_t<writer_type> fields(writer);
+                    arg.visit(fields);
+                    writer.EndObject(static_cast<rapidjson::SizeType>(arg.size()));
                 }
+                else if constexpr (std::is_same_v<type, raw_json_t>)
+                    writer.RawValue(arg.view().data(), arg.size(), rapidjson::kObjectType);
+
                 else
                     throw ex_internal_error("Invalid object type.");
             },
-                       obj.get_variant());
-            return obj_value;
+                       value.get_variant());
         }
 
-        const std::string
-        serialize_batch_request(const std::vector<request_t> &requests)
+        template <typename writer_type>
+        void write_request(writer_type &writer, const request_t &request)
         {
-            rapidjson::Document document;
-            document.SetArray();
-            auto &alloc = document.GetAllocator();
-            document.Reserve(requests.size(), alloc);
-            for (auto &e : requests)
+            if (!request.is_notification() && !request.get_id().has_value())
+                throw ex_internal_error("Request was not notification with null id.");
+
+            writer.StartObject();
+            writer.Key(JSON_PROTO);
+            writer.String(JSON_VER);
+            writer.Key(JSON_METHOD);
+            write_value(writer, request.get_method());
+            if (request.has_params())
             {
-                rapidjson::Value request;
-                request.SetObject();
-                request.AddMember(JSON_PROTO, JSON_VER, alloc);
-                request.AddMember(JSON_METHOD, rapidjson::Value(e.get_method().c_str(), alloc), alloc);
-                if (e.has_params())
-                {
-                    if (e.has_named_params())
-                    {
-                        rapidjson::Value params_value = get_obj_value(e.get_params_str(), alloc);
-                        if (params_value.IsNull())
-                            throw ex_internal_error("Batch params object was null.");
+                writer.Key(JSON_PARAMS);
+                if (request.has_named_params())
+                    write_value(writer, request.get_params_str());
 
-                        request.AddMember(JSON_PARAMS, params_value, alloc);
-                    }
-                    else
-                    {
-                        rapidjson::Value params_value = get_obj_value(e.get_params_arr(), alloc);
-                        if (params_value.IsNull())
-                            throw ex_internal_error("Batch params array was null.");
+                else
+                    write_value(writer, request.get_params_arr());
+            }
 
-                        request.AddMember(JSON_PARAMS, params_value, alloc);
-                    }
-                }
+            if (!request.is_notification())
+            {
+                writer.Key(JSON_ID);
+                write_id(writer, request.get_id());
+            }
+            writer.EndObject();
+        }
 
-                if (!e.is_notification())
-                {
-                    auto id_value = get_id_value(e.get_id(), alloc);
-                    if (id_value.IsNull())
-                        throw ex_internal_error("Batch request was not notification with null id.");
+        void append_value(std::string &output, const value_t &value)
+        {
+            string_stream_t stream(output);
+            write_value(get_writer(stream), value);
+        }
 
-                    request.AddMember(JSON_ID, id_value, alloc);
-                }
-                document.PushBack(request, alloc);
+        template <typename int_type>
+        void append_int(std::string &output, const int_type &number)
+        {
+            char buffer[24];
+            auto end = std::to_chars(buffer, buffer + sizeof(buffer), number).ptr;
+            output.append(buffer, end);
+        }
+
+        //integer ids are formatted in place, string ids go through the writer for escaping
+        void append_id(std::string &output, const value_t &id)
+        {
+            auto &variant = id.get_variant();
+            if (auto number = std::get_if<int32_t>(&variant))
+                return append_int(output, *number);
+
+            if (auto number = std::get_if<int64_t>(&variant))
+                return append_int(output, *number);
+
+            string_stream_t stream(output);
+            write_id(get_writer(stream), id);
+        }
+
+        //the standard errors raised by the server, with the envelope, code and message encoded once.
+        //each body is left open for the optional data member
+        struct error_body_t
+        {
+            int code;
+            std::string message, body;
+        };
+
+        const std::vector<error_body_t> &get_error_bodies()
+        {
+            static const std::vector<error_body_t> bodies = [] {
+                std::vector<error_body_t> bodies;
+                auto add = [&](const int &code, const std::string &message) {
+                    std::string body(ERROR_PREFIX);
+                    append_int(body, code);
+                    body.append(MESSAGE_MEMBER);
+                    append_value(body, message);
+                    bodies.push_back({code, message, std::move(body)});
+                };
+                add(-32700, ex_parse_error().what());
+                add(-32600, ex_bad_request().what());
+                add(-32601, ex_bad_method().what());
+                add(-32602, ex_bad_params().what());
+                add(-32603, ex_internal_error().what());
+                add(-32000, ex_method_used().what());
+                add(-32098, ex_unknown().what());
+                add(-32099, ex_unknown().what());
+                return bodies;
+            }();
+            return bodies;
+        }
+
+        //streams a success response straight into output, no document or response_t is built
+        void write_result(std::string &output, const value_t &value, const value_t &id)
+        {
+            if (!id.has_value())
+                throw ex_internal_error("Response was not notification with null id.");
+
+            output.append(RESULT_PREFIX);
+            append_value(output, value);
+            output.append(ID_MEMBER);
+            append_id(output, id);
+            output.push_back('}');
+        }
+
+        //splices an already serialized result value into the response
+        void write_raw_result(std::string &output, const std::string_view &fragment, const value_t &id)
+        {
+            if (!id.has_value())
+                throw ex_internal_error("Response was not notification with null id.");
+
+            output.append(RESULT_PREFIX);
+            output.append(fragment);
+            output.append(ID_MEMBER);
+            append_id(output, id);
+            output.push_back('}');
+        }
+
+        void write_error(std::string &output, const response_t &error)
+        {
+            auto code = error.get_code();
+            auto message = error.get_message();
+            auto &bodies = get_error_bodies();
+            auto body = std::find_if(bodies.begin(), bodies.end(), [&](auto &e) { return e.code == code && e.message == message; });
+            if (body != bodies.end())
+                output.append(body->body);
+
+            else
+            {
+                output.append(ERROR_PREFIX);
+                append_int(output, code);
+                output.append(MESSAGE_MEMBER);
+                append_value(output, message);
+            }
+
+            if (auto data = error.get_data(); data.has_value())
+            {
+                output.append(DATA_MEMBER);
+                append_value(output, data);
+            }
+            output.push_back('}');
+            output.append(ID_MEMBER);
+            append_id(output, error.get_id());
+            output.push_back('}');
+        }
+
+        void write_response(std::string &output, const response_t &response)
+        {
+            if (response.has_error())
+                write_error(output, response);
+
+            else
+                write_result(output, response.get_value(), response.get_id());
+        }
+
+        //assembles a batch response from element responses that are already serialized, in the order they
+        //are handed in. json arrays need no length up front, so everything written so far can be sent early
+        class batch_writer_t
+        {
+            std::size_t m_count = 0;
+
+        public:
+            static constexpr bool streams = true;
+
+            //appends what goes before the next element
+            void next(std::string &output)
+            {
+                output.push_back(m_count++ == 0 ? '[' : ',');
             }
-            rapidjson::StringBuffer strbuf;
-            rapidjson::Writer writer(strbuf);
-            document.Accept(writer);
-            return strbuf.GetString();
+
+            void finish(std::string &output)
+            {
+                if (m_count == 0)
+                    output.push_back('[');
+
+                output.push_back(']');
+            }
+        };
+
+        const std::string
+        serialize_value(const value_t &value)
+        {
+            std::string output;
+            append_value(output, value);
+            return output;
+        }
+
+        const std::string
+        serialize_batch_request(const std::vector<request_t> &requests)
+        {
+            std::string output;
+            string_stream_t stream(output);
+            string_writer_t writer(stream);
+            writer.StartArray();
+            for (auto &e : requests)
+                write_request(writer, e);
+
+            writer.EndArray();
+            return output;
         }
 
         const std::string
         serialize_batch_response(const std::vector<response_t> &responses)
         {
-            rapidjson::Document document;
-            document.SetArray();
-            auto &alloc = document.GetAllocator();
-            document.Reserve(responses.size(), alloc);
+            std::string output(1, '[');
             for (auto &e : responses)
             {
                 if (e.is_notification() && !e.has_error())
                     continue;
 
-                rapidjson::Value response;
-                response.SetObject();
-                response.AddMember(JSON_PROTO, JSON_VER, alloc);
-                auto id_value = get_id_value(e.get_id(), alloc);
-                if (e.has_error())
-                {
-                    auto code_value = get_obj_value(e.get_code(), alloc);
-                    if (code_value.IsNull())
-                        throw ex_internal_error("Batch null code value.");
-
-                    auto message_value = get_obj_value(e.get_message(), alloc);
-                    if (message_value.IsNull())
-                        throw ex_internal_error("Batch null message value.");
-
-                    auto data_value = get_obj_value(e.get_data(), alloc);
-                    rapidjson::Value error_obj;
-                    error_obj.SetObject();
-                    error_obj.AddMember(JSON_CODE, code_value, alloc);
-                    error_obj.AddMember(JSON_MESSAGE, message_value, alloc);
-                    if (!data_value.IsNull())
-                        error_obj.AddMember(JSON_DATA, data_value, alloc);
-
-                    response.AddMember(JSON_ERROR, error_obj, alloc);
-                }
-                else
-                {
-                    if (id_value.IsNull())
-                        throw ex_internal_error("Batch response was not notification with null id.");
+                if (output.size() > 1)
+                    output.push_back(',');
 
-                    auto result_value = get_obj_value(e.get_value(), alloc);
-                    response.AddMember(JSON_RESULT, result_value, alloc);
-                }
-                response.AddMember(JSON_ID, id_value, alloc);
-                document.PushBack(response, alloc);
+                write_response(output, e);
             }
-            rapidjson::StringBuffer strbuf;
-            rapidjson::Writer writer(strbuf);
-            document.Accept(writer);
-            return strbuf.GetString();
+            output.push_back(']');
+            return output;
         }
 
         const std::string
         serialize_request(const request_t &request)
         {
-            rapidjson::Document document;
-            document.SetObject();
-            auto &alloc = document.GetAllocator();
-            document.AddMember(JSON_PROTO, JSON_VER, alloc);
-            document.AddMember(JSON_METHOD, rapidjson::Value(request.get_method().c_str(), alloc), alloc);
-            if (request.has_params())
-            {
-                if (request.has_named_params())
-                {
-                    rapidjson::Value params_value = get_obj_value(request.get_params_str(), alloc);
-                    if (params_value.IsNull())
-                        throw ex_internal_error("Params object was null.");
-
-                    document.AddMember(JSON_PARAMS, params_value, alloc);
-                }
-                else
-                {
-                    rapidjson::Value params_value = get_obj_value(request.get_params_arr(), alloc);
-                    if (params_value.IsNull())
-                        throw ex_internal_error("Params array was null.");
-
-                    document.AddMember(JSON_PARAMS, params_value, alloc);
-                }
-            }
-
-            if (!request.is_notification())
-            {
-                auto id_value = get_id_value(request.get_id(), alloc);
-                if (id_value.IsNull())
-                    throw ex_internal_error("Request was not notification with null id.");
-
-                document.AddMember(JSON_ID, id_value, alloc);
-            }
-            rapidjson::StringBuffer strbuf;
-            rapidjson::Writer writer(strbuf);
-            document.Accept(writer);
-            return strbuf.GetString();
+            std::string output;
+            string_stream_t stream(output);
+            string_writer_t writer(stream);
+            write_request(writer, request);
+            return output;
         }
 
         const std::string
@@ -237,44 +412,9 @@ namespace rpc_light
             if (response.is_notification() && !response.has_error())
                 return "";
 
-            rapidjson::Document document;
-            document.SetObject();
-            auto &alloc = document.GetAllocator();
-            document.AddMember(JSON_PROTO, JSON_VER, alloc);
-            auto id_value = get_id_value(response.get_id(), alloc);
-            if (response.has_error())
-            {
-                auto code_value = get_obj_value(response.get_code(), alloc);
-                if (code_value.IsNull())
-                    throw ex_internal_error("Null code value.");
-
-                auto message_value = get_obj_value(response.get_message(), alloc);
-                if (message_value.IsNull())
-                    throw ex_internal_error("Null message value.");
-
-                auto data_value = get_obj_value(response.get_data(), alloc);
-                rapidjson::Value error_obj;
-                error_obj.SetObject();
-                error_obj.AddMember(JSON_CODE, code_value, alloc);
-                error_obj.AddMember(JSON_MESSAGE, message_value, alloc);
-                if (!data_value.IsNull())
-                    error_obj.AddMember(JSON_DATA, data_value, alloc);
-
-                document.AddMember(JSON_ERROR, error_obj, alloc);
-            }
-            else
-            {
-                if (id_value.IsNull())
-                    throw ex_internal_error("Response was not notification with null id.");
-
-                auto result_value = get_obj_value(response.get_value(), alloc);
-                document.AddMember(JSON_RESULT, result_value, alloc);
-            }
-            document.AddMember(JSON_ID, id_value, alloc);
-            rapidjson::StringBuffer strbuf;
-            rapidjson::Writer writer(strbuf);
-            document.Accept(writer);
-            return strbuf.GetString();
+            std::string output;
+            write_response(output, response);
+            return output;
         }
     }; // namespace writer
 } // namespace rpc_light
\ No newline at end of file